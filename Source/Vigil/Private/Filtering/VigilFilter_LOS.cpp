@@ -10,6 +10,7 @@
 #include "CollisionShape.h"
 #include "Engine/World.h"
 #include "System/VigilVersioning.h"
+#include "System/VigilLOSCache.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilFilter_LOS)
 
@@ -26,6 +27,37 @@ namespace FVigilCVars
 #endif
 }
 
+namespace VigilLOSStats
+{
+	/** Number of targets decided by each tier */
+	static int64 Distance = 0;
+	static int64 Occluder = 0;
+	static int64 RecentlyRendered = 0;
+	static int64 Cache = 0;
+	static int64 Traced = 0;
+
+	static FAutoConsoleCommand CmdLOSStats(
+		TEXT("p.Vigil.Filter.LOSStats"),
+		TEXT("Log how many Vigil LOS filter targets were decided by each pre-filter tier instead of a trace.\n")
+		TEXT("Pass 'reset' to reset the stats"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("reset"), ESearchCase::IgnoreCase))
+			{
+				Distance = 0;
+				Occluder = 0;
+				RecentlyRendered = 0;
+				Cache = 0;
+				Traced = 0;
+				return;
+			}
+			const int64 Avoided = Distance + Occluder + RecentlyRendered + Cache;
+			const int64 Total = Avoided + Traced;
+			UE_LOG(LogVigil, Log, TEXT("Vigil LOS filter: Distance: %lld Occluder: %lld RecentlyRendered: %lld Cache: %lld Traced: %lld Traces avoided: %.1f%%"),
+				Distance, Occluder, RecentlyRendered, Cache, Traced, Total > 0 ? 100.0 * Avoided / Total : 0.0);
+		}));
+}
+
 UVigilFilter_LOS::UVigilFilter_LOS(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 {
@@ -48,28 +80,23 @@ bool UVigilFilter_LOS::ShouldFilterTarget(const FTargetingRequestHandle& Targeti
 	const UWorld* World = GetSourceContextWorld(TargetingHandle);
 	if (World && TargetingHandle.IsValid())
 	{
-		const AActor* TargetActor = TargetData.HitResult.GetActor();
-		if (!TargetActor || !TargetActor->GetRootComponent())
+		FVector TargetLocation;
+		FCollisionQueryParams TraceParams(TEXT("UVigilTargetingFilterTask_LOS"), SCENE_QUERY_STAT_ONLY(UVigilTargetingFilterTask_LOS), false);
+		bool bIgnoreMobility;
+		if (!InitTrace(TargetingHandle, TargetData, TargetLocation, TraceParams, bIgnoreMobility))
 		{
 			return true;
 		}
-		const FVector SourceLocation = GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
-		FCollisionQueryParams TraceParams(TEXT("UVigilTargetingFilterTask_LOS"), SCENE_QUERY_STAT_ONLY(UVigilTargetingFilterTask_LOS), false);
-		InitCollisionParams(TargetingHandle, TraceParams);
 
-		// Conditionally ignore based on target mobility
-		const bool bIgnoreMobility = IgnoreTargetMobility.Contains(TargetActor->GetRootComponent()->Mobility);
-		if (bIgnoreMobility)
-		{
-			TraceParams.AddIgnoredActor(TargetActor);
-		}
-		
-		FVector TargetLocation = TargetActor->GetActorLocation();
-		if (TargetLocationSource == EVigilTargetLocationSource_LOS::BoundsOrigin)
+		const FVector SourceLocation = GetCachedSourceLocation(TargetingHandle);
+
+		bool bFiltered;
+		if (PreFilterTarget(World, SourceLocation, TargetLocation, TargetData.HitResult.GetActor(), bFiltered))
 		{
-			FVector NotUsed;
-			TargetActor->GetActorBounds(true, TargetLocation, NotUsed);
+			return bFiltered;
 		}
+
+		RecordTrace();
 		
 		FHitResult Hit;
 		const bool bSphereTrace = TraceRadius > 0.f;
@@ -122,46 +149,194 @@ bool UVigilFilter_LOS::ShouldFilterTarget(const FTargetingRequestHandle& Targeti
 			}
 		}
 
+		DebugDrawTrace(World, SourceLocation, Hit);
+
+		bFiltered = ShouldFilterTraceResult(Hit, TargetData.HitResult.GetActor(), bIgnoreMobility);
+		CacheVerdict(World, SourceLocation, TargetLocation, TargetData.HitResult.GetActor(), bFiltered);
+		return bFiltered;
+	}
+
+	// We don't have LOS to our target, so we need to filter it out
+	return true;
+}
+
+bool UVigilFilter_LOS::InitTrace(const FTargetingRequestHandle& TargetingHandle,
+	const FTargetingDefaultResultData& TargetData, FVector& OutTargetLocation, FCollisionQueryParams& OutParams,
+	bool& bOutIgnoreMobility) const
+{
+	const AActor* TargetActor = TargetData.HitResult.GetActor();
+	if (!TargetActor || !TargetActor->GetRootComponent())
+	{
+		return false;
+	}
+
+	InitCollisionParams(TargetingHandle, OutParams);
+
+	// Conditionally ignore based on target mobility
+	bOutIgnoreMobility = IgnoreTargetMobility.Contains(TargetActor->GetRootComponent()->Mobility);
+	if (bOutIgnoreMobility)
+	{
+		OutParams.AddIgnoredActor(TargetActor);
+	}
+	
+	OutTargetLocation = TargetActor->GetActorLocation();
+	if (TargetLocationSource == EVigilTargetLocationSource_LOS::BoundsOrigin)
+	{
+		FVector NotUsed;
+		TargetActor->GetActorBounds(true, OutTargetLocation, NotUsed);
+	}
+	return true;
+}
+
+bool UVigilFilter_LOS::ShouldFilterTraceResult(const FHitResult& Hit, const AActor* TargetActor, bool bIgnoreMobility)
+{
+	// Note -- we filter out if there is no LOS
+	// So we return true if we don't have LOS
+	
+	// If our target is ignored by mobility (generally, movable), and we hit nothing, then we have line of sight
+	if (bIgnoreMobility)
+	{
+		// We hit something, so we don't have LOS, we need to filter it
+		return Hit.bBlockingHit;
+	}
+
+	// We only have line of sight to our target if we hit it, i.e. nothing interfered
+	if (Hit.bBlockingHit && Hit.GetActor() == TargetActor)
+	{
+		return false;
+	}
+
+	// We don't have LOS to our target, so we need to filter it out
+	return true;
+}
+
+void UVigilFilter_LOS::DebugDrawTrace(const UWorld* World, const FVector& SourceLocation, const FHitResult& Hit) const
+{
 #if UE_ENABLE_DEBUG_DRAWING
-		if (FVigilCVars::bVigilFilterDebug)
-		{
-			const FColor& DebugColor = Hit.bBlockingHit ? FColor::Red : FColor::Green;
+	if (FVigilCVars::bVigilFilterDebug)
+	{
+		const FColor& DebugColor = Hit.bBlockingHit ? FColor::Red : FColor::Green;
 #if UE_5_04_OR_LATER
-			const float LifeTime = UTargetingSubsystem::GetOverrideTargetingLifeTime();
+		const float LifeTime = UTargetingSubsystem::GetOverrideTargetingLifeTime();
 #else
-			constexpr float LifeTime = 0.f;
+		constexpr float LifeTime = 0.f;
 #endif
-			if (bSphereTrace)
-			{
-				DrawDebugSphere(World, Hit.ImpactPoint, TraceRadius, 12, DebugColor, false, LifeTime);
-			}
-			else
+		if (TraceRadius > 0.f)
+		{
+			DrawDebugSphere(World, Hit.ImpactPoint, TraceRadius, 12, DebugColor, false, LifeTime);
+		}
+		else
+		{
+			DrawDebugLine(World, SourceLocation, Hit.ImpactPoint, DebugColor, false,
+				LifeTime, 0, 1.f);
+		}
+	}
+#endif
+}
+
+bool UVigilFilter_LOS::PreFilterTarget(const UWorld* World, const FVector& SourceLocation,
+	const FVector& TargetLocation, const AActor* TargetActor, bool& bOutFiltered) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_LOS::PreFilterTarget);
+
+	// Too far away to bother
+	if (MaxTraceDistance > 0.f && FVector::DistSquared(SourceLocation, TargetLocation) > FMath::Square(MaxTraceDistance))
+	{
+		VigilLOSStats::Distance++;
+		bOutFiltered = true;
+		return true;
+	}
+
+	// Behind a known static occluder
+	if (!OccluderTag.IsNone())
+	{
+		if (UVigilLOSCache* LOSCache = World ? World->GetSubsystem<UVigilLOSCache>() : nullptr)
+		{
+			if (LOSCache->IsOccluded(OccluderTag, SourceLocation, TargetLocation))
 			{
-				DrawDebugLine(World, SourceLocation, Hit.ImpactPoint, DebugColor, false,
-					LifeTime, 0, 1.f);
+				VigilLOSStats::Occluder++;
+				bOutFiltered = true;
+				return true;
 			}
 		}
-#endif
+	}
 
-		// Note -- we filter out if there is no LOS
-		// So we return true if we don't have LOS
-		
-		// If our target is ignored by mobility (generally, movable), and we hit nothing, then we have line of sight
-		if (bIgnoreMobility)
+	// Recently rendered, the camera can see it
+	if (bPassRecentlyRendered && TargetActor && World && World->GetNetMode() != NM_DedicatedServer &&
+		TargetActor->WasRecentlyRendered(RecentlyRenderedTolerance))
+	{
+		VigilLOSStats::RecentlyRendered++;
+		bOutFiltered = false;
+		return true;
+	}
+
+	if (FindCachedVerdict(World, SourceLocation, TargetLocation, TargetActor, bOutFiltered))
+	{
+		VigilLOSStats::Cache++;
+		return true;
+	}
+
+	return false;
+}
+
+void UVigilFilter_LOS::RecordTrace()
+{
+	VigilLOSStats::Traced++;
+}
+
+uint32 UVigilFilter_LOS::GetLOSCacheQueryHash() const
+{
+	uint32 Hash = GetTypeHash(CollisionChannel.GetValue());
+	Hash = HashCombine(Hash, GetTypeHash(CollisionProfileName.Name));
+	for (const TEnumAsByte<EObjectTypeQuery>& ObjectType : CollisionObjectTypes)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(ObjectType.GetValue()));
+	}
+	for (const TEnumAsByte<EComponentMobility::Type>& Mobility : IgnoreTargetMobility)
+	{
+		Hash = HashCombine(Hash, GetTypeHash(Mobility.GetValue()));
+	}
+	Hash = HashCombine(Hash, GetTypeHash(TraceRadius));
+	Hash = HashCombine(Hash, GetTypeHash(static_cast<uint8>(TargetLocationSource)));
+	Hash = HashCombine(Hash, (bIgnoreSourceActor ? 1 : 0) | (bIgnoreInstigatorActor ? 2 : 0) | (bTraceComplex ? 4 : 0));
+	return Hash;
+}
+
+bool UVigilFilter_LOS::FindCachedVerdict(const UWorld* World, const FVector& SourceLocation,
+	const FVector& TargetLocation, const AActor* TargetActor, bool& bOutFiltered) const
+{
+	if (bUseLOSCache)
+	{
+		if (UVigilLOSCache* Cache = UVigilLOSCache::Get(World))
 		{
-			// We hit something, so we don't have LOS, we need to filter it
-			return Hit.bBlockingHit;
+			const FVigilLOSCacheKey Key = UVigilLOSCache::MakeKey(GetLOSCacheQueryHash(), SourceLocation, TargetActor);
+			return Cache->FindVerdict(Key, SourceLocation, TargetLocation, bOutFiltered);
 		}
+	}
+	return false;
+}
 
-		// We only have line of sight to our target if we hit it, i.e. nothing interfered
-		if (Hit.bBlockingHit && Hit.GetActor() == TargetActor)
+void UVigilFilter_LOS::CacheVerdict(const UWorld* World, const FVector& SourceLocation,
+	const FVector& TargetLocation, const AActor* TargetActor, bool bFiltered) const
+{
+	if (bUseLOSCache)
+	{
+		if (UVigilLOSCache* Cache = UVigilLOSCache::Get(World))
 		{
-			return false;
+			const FVigilLOSCacheKey Key = UVigilLOSCache::MakeKey(GetLOSCacheQueryHash(), SourceLocation, TargetActor);
+			Cache->AddVerdict(Key, SourceLocation, TargetLocation, bFiltered);
 		}
 	}
+}
 
-	// We don't have LOS to our target, so we need to filter it out
-	return true;
+FVector UVigilFilter_LOS::GetCachedSourceLocation(const FTargetingRequestHandle& TargetingHandle) const
+{
+	FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+	if (const FVector* SourceLocation = RequestData.TaskSourceLocations.Find(FObjectKey(this)))
+	{
+		return *SourceLocation;
+	}
+	return RequestData.TaskSourceLocations.Add(FObjectKey(this), GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle));
 }
 
 void UVigilFilter_LOS::InitCollisionParams(const FTargetingRequestHandle& TargetingHandle,
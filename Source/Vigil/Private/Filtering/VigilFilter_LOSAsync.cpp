@@ -0,0 +1,205 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Filtering/VigilFilter_LOSAsync.h"
+
+#include "Targeting/VigilTargetingTypes.h"
+#include "Engine/World.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilFilter_LOSAsync)
+
+
+void UVigilFilter_LOSAsync::Execute(const FTargetingRequestHandle& TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_LOSAsync::Execute);
+
+	if (!IsAsyncTargetingRequest(TargetingHandle))
+	{
+		Super::Execute(TargetingHandle);
+		return;
+	}
+
+	// Skip UTargetingFilterTask_BasicFilterTemplate, which filters each target synchronously
+	UTargetingTask::Execute(TargetingHandle);
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Executing);
+	ExecuteAsyncTraces(TargetingHandle);
+}
+
+void UVigilFilter_LOSAsync::ExecuteAsyncTraces(const FTargetingRequestHandle& TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_LOSAsync::ExecuteAsyncTraces);
+
+	UWorld* World = GetSourceContextWorld(TargetingHandle);
+	const FTargetingDefaultResultsSet* Results = TargetingHandle.IsValid() ? FTargetingDefaultResultsSet::Find(TargetingHandle) : nullptr;
+	if (!World || !Results || Results->TargetResults.Num() == 0)
+	{
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+		return;
+	}
+
+	const FVector SourceLocation = GetCachedSourceLocation(TargetingHandle);
+
+	FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+	FVigilAsyncFilterState& State = RequestData.AsyncFilterStates.Add(FObjectKey(this));
+
+	const int32 NumTargets = Results->TargetResults.Num();
+	State.Targets.Reset(NumTargets);
+	State.Filtered.Init(0, NumTargets);
+	State.IgnoreMobility.Init(0, NumTargets);
+	State.TargetLocations.Init(FVector::ZeroVector, NumTargets);
+	State.NumPending = 0;
+
+	// The target index is the trace's user data
+	const FTraceDelegate Delegate = FTraceDelegate::CreateUObject(this, &ThisClass::HandleAsyncTraceComplete, TargetingHandle);
+	for (int32 TargetIndex = 0; TargetIndex < NumTargets; ++TargetIndex)
+	{
+		const FTargetingDefaultResultData& TargetData = Results->TargetResults[TargetIndex];
+		State.Targets.Add(FVigilTargetingRequestData::GetCandidateKey(TargetData));
+
+		FVector TargetLocation;
+		FCollisionQueryParams TraceParams(TEXT("UVigilTargetingFilterTask_LOSAsync"), SCENE_QUERY_STAT_ONLY(UVigilTargetingFilterTask_LOSAsync), false);
+		bool bIgnoreMobility;
+		if (!InitTrace(TargetingHandle, TargetData, TargetLocation, TraceParams, bIgnoreMobility))
+		{
+			State.Filtered[TargetIndex] = 1;
+			continue;
+		}
+
+		bool bFiltered;
+		if (PreFilterTarget(World, SourceLocation, TargetLocation, TargetData.HitResult.GetActor(), bFiltered))
+		{
+			State.Filtered[TargetIndex] = bFiltered ? 1 : 0;
+			continue;
+		}
+
+		RecordTrace();
+
+		State.IgnoreMobility[TargetIndex] = bIgnoreMobility ? 1 : 0;
+		State.TargetLocations[TargetIndex] = TargetLocation;
+		State.NumPending++;
+		StartAsyncTrace(World, SourceLocation, TargetLocation, TraceParams, Delegate, static_cast<uint32>(TargetIndex));
+	}
+
+	// Nothing could be traced
+	if (State.NumPending == 0)
+	{
+		ApplyFilterResults(TargetingHandle, State);
+		RequestData.AsyncFilterStates.Remove(FObjectKey(this));
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+	}
+}
+
+void UVigilFilter_LOSAsync::StartAsyncTrace(UWorld* World, const FVector& Start, const FVector& End,
+	const FCollisionQueryParams& Params, const FTraceDelegate& Delegate, uint32 UserData) const
+{
+	const bool bSphereTrace = TraceRadius > 0.f;
+	const FCollisionShape Sphere = FCollisionShape::MakeSphere(TraceRadius);
+
+	if (CollisionObjectTypes.Num() > 0)
+	{
+		FCollisionObjectQueryParams ObjectParams;
+		for (auto Iter = CollisionObjectTypes.CreateConstIterator(); Iter; ++Iter)
+		{
+			const ECollisionChannel& Channel = UCollisionProfile::Get()->ConvertToCollisionChannel(false, *Iter);
+			ObjectParams.AddObjectTypesToQuery(Channel);
+		}
+
+		if (bSphereTrace)
+		{
+			World->AsyncSweepByObjectType(EAsyncTraceType::Single, Start, End, FQuat::Identity, ObjectParams, Sphere,
+				Params, &Delegate, UserData);
+		}
+		else
+		{
+			World->AsyncLineTraceByObjectType(EAsyncTraceType::Single, Start, End, ObjectParams, Params, &Delegate,
+				UserData);
+		}
+	}
+	else if (CollisionProfileName.Name != TEXT("NoCollision"))
+	{
+		if (bSphereTrace)
+		{
+			World->AsyncSweepByProfile(EAsyncTraceType::Single, Start, End, FQuat::Identity, CollisionProfileName.Name,
+				Sphere, Params, &Delegate, UserData);
+		}
+		else
+		{
+			World->AsyncLineTraceByProfile(EAsyncTraceType::Single, Start, End, CollisionProfileName.Name, Params,
+				&Delegate, UserData);
+		}
+	}
+	else
+	{
+		if (bSphereTrace)
+		{
+			World->AsyncSweepByChannel(EAsyncTraceType::Single, Start, End, FQuat::Identity, CollisionChannel, Sphere,
+				Params, FCollisionResponseParams::DefaultResponseParam, &Delegate, UserData);
+		}
+		else
+		{
+			World->AsyncLineTraceByChannel(EAsyncTraceType::Single, Start, End, CollisionChannel, Params,
+				FCollisionResponseParams::DefaultResponseParam, &Delegate, UserData);
+		}
+	}
+}
+
+void UVigilFilter_LOSAsync::HandleAsyncTraceComplete(const FTraceHandle& InTraceHandle, FTraceDatum& InTraceDatum,
+	FTargetingRequestHandle TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_LOSAsync::HandleAsyncTraceComplete);
+
+	FVigilTargetingRequestData* RequestData = TargetingHandle.IsValid() ? FVigilTargetingRequestData::Find(TargetingHandle) : nullptr;
+	FVigilAsyncFilterState* State = RequestData ? RequestData->AsyncFilterStates.Find(FObjectKey(this)) : nullptr;
+	if (!State || State->NumPending <= 0)
+	{
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+		return;
+	}
+
+	const FTargetingDefaultResultsSet* Results = FTargetingDefaultResultsSet::Find(TargetingHandle);
+	const int32 TargetIndex = static_cast<int32>(InTraceDatum.UserData);
+	if (Results && Results->TargetResults.IsValidIndex(TargetIndex) && State->Filtered.IsValidIndex(TargetIndex))
+	{
+		const FHitResult Hit = InTraceDatum.OutHits.Num() > 0 ? InTraceDatum.OutHits[0] : FHitResult();
+		const AActor* TargetActor = Results->TargetResults[TargetIndex].HitResult.GetActor();
+		const bool bFiltered = ShouldFilterTraceResult(Hit, TargetActor, State->IgnoreMobility[TargetIndex] != 0);
+		State->Filtered[TargetIndex] = bFiltered ? 1 : 0;
+
+		const UWorld* World = GetSourceContextWorld(TargetingHandle);
+		DebugDrawTrace(World, InTraceDatum.Start, Hit);
+		CacheVerdict(World, InTraceDatum.Start, State->TargetLocations[TargetIndex], TargetActor, bFiltered);
+	}
+
+	// Wait for every trace
+	if (--State->NumPending > 0)
+	{
+		return;
+	}
+
+	ApplyFilterResults(TargetingHandle, *State);
+	RequestData->AsyncFilterStates.Remove(FObjectKey(this));
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+}
+
+void UVigilFilter_LOSAsync::ApplyFilterResults(const FTargetingRequestHandle& TargetingHandle,
+	const FVigilAsyncFilterState& State) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_LOSAsync::ApplyFilterResults);
+
+	FTargetingDefaultResultsSet* Results = FTargetingDefaultResultsSet::Find(TargetingHandle);
+	if (!Results)
+	{
+		return;
+	}
+
+	TArray<FTargetingDefaultResultData>& TargetResults = Results->TargetResults;
+	for (int32 TargetIndex = TargetResults.Num() - 1; TargetIndex >= 0; --TargetIndex)
+	{
+		if (State.Filtered.IsValidIndex(TargetIndex) && State.Filtered[TargetIndex] &&
+			State.Targets[TargetIndex] == FVigilTargetingRequestData::GetCandidateKey(TargetResults[TargetIndex]))
+		{
+			TargetResults.RemoveAt(TargetIndex);
+		}
+	}
+}
@@ -0,0 +1,228 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Filtering/VigilFilter_PawnRelationship.h"
+
+#include "Targeting/VigilTargetingTypes.h"
+#include "GenericTeamAgentInterface.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "System/VigilVersioning.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilFilter_PawnRelationship)
+
+namespace FVigilCVars
+{
+	static int32 VigilFilterParallelThreshold = 256;
+	FAutoConsoleVariableRef CVarVigilFilterParallelThreshold(
+		TEXT("p.Vigil.Filter.ParallelThreshold"),
+		VigilFilterParallelThreshold,
+		TEXT("Filter tasks that can filter in parallel do so once there are at least this many targets, 0 to disable"),
+		ECVF_Default);
+}
+
+void UVigilFilter_PawnRelationship::Execute(const FTargetingRequestHandle& TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_PawnRelationship::Execute);
+
+	// Skip UTargetingFilterTask_BasicFilterTemplate, which resolves everything again for each target
+	UTargetingTask::Execute(TargetingHandle);
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Executing);
+
+	FTargetingDefaultResultsSet* Results = TargetingHandle.IsValid() ? FTargetingDefaultResultsSet::Find(TargetingHandle) : nullptr;
+	const APawn* SourcePawn = Results ? GetSourcePawn(TargetingHandle) : nullptr;
+	if (Results && SourcePawn)
+	{
+		TArray<FTargetingDefaultResultData>& TargetResults = Results->TargetResults;
+		TArray<uint8> Filtered;
+		const bool bParallel = ShouldFilterInParallel(TargetResults.Num());
+		if (bParallel)
+		{
+			FilterTargetsInParallel(TargetingHandle, SourcePawn, TargetResults, Filtered);
+		}
+
+		// Compact the results in place, keeping their order
+		int32 SourceTeamId = INDEX_NONE;
+		int32 NumKept = 0;
+		for (int32 TargetIndex = 0; TargetIndex < TargetResults.Num(); ++TargetIndex)
+		{
+			const bool bFiltered = bParallel ? Filtered[TargetIndex] != 0 :
+				ShouldFilterTargetInternal(TargetingHandle, SourcePawn, TargetResults[TargetIndex].HitResult.GetActor(), SourceTeamId);
+			if (!bFiltered)
+			{
+				if (NumKept != TargetIndex)
+				{
+					TargetResults[NumKept] = MoveTemp(TargetResults[TargetIndex]);
+				}
+				NumKept++;
+			}
+		}
+#if UE_5_04_OR_LATER
+		TargetResults.SetNum(NumKept, EAllowShrinking::No);
+#else
+		TargetResults.SetNum(NumKept, false);
+#endif
+	}
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+}
+
+bool UVigilFilter_PawnRelationship::ShouldFilterTarget(const FTargetingRequestHandle& TargetingHandle,
+	const FTargetingDefaultResultData& TargetData) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_PawnRelationship::ShouldFilterTarget);
+
+	const APawn* SourcePawn = GetSourcePawn(TargetingHandle);
+	if (!SourcePawn)
+	{
+		return false;
+	}
+
+	int32 SourceTeamId = INDEX_NONE;
+	return ShouldFilterTargetInternal(TargetingHandle, SourcePawn, TargetData.HitResult.GetActor(), SourceTeamId);
+}
+
+bool UVigilFilter_PawnRelationship::ShouldFilterInParallel(int32 NumTargets) const
+{
+	if (FVigilCVars::VigilFilterParallelThreshold <= 0 || NumTargets < FVigilCVars::VigilFilterParallelThreshold)
+	{
+		return false;
+	}
+
+	// Blueprint overrides must run on the game thread
+	if (GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UVigilFilter_PawnRelationship, ShouldIgnorePawn)))
+	{
+		return false;
+	}
+
+	// Our own ShouldIgnorePawn_Implementation is safe, native subclasses may override it so they must opt in
+	const UClass* NativeClass = GetClass();
+	while (NativeClass && !NativeClass->HasAnyClassFlags(CLASS_Native))
+	{
+		NativeClass = NativeClass->GetSuperClass();
+	}
+	return NativeClass == UVigilFilter_PawnRelationship::StaticClass() || CanFilterInParallel();
+}
+
+void UVigilFilter_PawnRelationship::FilterTargetsInParallel(const FTargetingRequestHandle& TargetingHandle,
+	const APawn* SourcePawn, const TArray<FTargetingDefaultResultData>& TargetResults, TArray<uint8>& OutFiltered) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilFilter_PawnRelationship::FilterTargetsInParallel);
+
+	// Team lookups go through game interfaces and write our cache, resolve them here so the workers only read
+	const int32 NumTargets = TargetResults.Num();
+	const bool bFilterAttitude = bFilterFriendly || bFilterNeutral || bFilterHostile;
+	const uint8 SourceTeamId = bFilterAttitude ? GetCachedTeamId(TargetingHandle, SourcePawn) : FGenericTeamId::NoTeam.GetId();
+
+	TArray<const APawn*> TargetPawns;
+	TArray<uint8> TargetTeamIds;
+	TargetPawns.SetNumUninitialized(NumTargets);
+	TargetTeamIds.SetNumUninitialized(NumTargets);
+	for (int32 TargetIndex = 0; TargetIndex < NumTargets; ++TargetIndex)
+	{
+		const APawn* TargetPawn = Cast<APawn>(TargetResults[TargetIndex].HitResult.GetActor());
+		TargetPawns[TargetIndex] = TargetPawn;
+		TargetTeamIds[TargetIndex] = bFilterAttitude && TargetPawn ? GetCachedTeamId(TargetingHandle, TargetPawn) : FGenericTeamId::NoTeam.GetId();
+	}
+
+	// Each target is decided on its own, the same as ShouldFilterTargetInternal
+	OutFiltered.SetNumUninitialized(NumTargets);
+	ParallelFor(NumTargets, [this, SourcePawn, SourceTeamId, bFilterAttitude, &TargetPawns, &TargetTeamIds, &OutFiltered](int32 TargetIndex)
+	{
+		const APawn* TargetPawn = TargetPawns[TargetIndex];
+		if (!TargetPawn)
+		{
+			OutFiltered[TargetIndex] = bFilterNonPawns ? 1 : 0;
+			return;
+		}
+
+		const bool bFiltered = (bFilterAttitude && ShouldFilterAttitude(SourceTeamId, TargetTeamIds[TargetIndex])) ||
+			ShouldIgnorePawn_Implementation(SourcePawn, TargetPawn);
+		OutFiltered[TargetIndex] = bFiltered ? 1 : 0;
+	});
+}
+
+bool UVigilFilter_PawnRelationship::ShouldFilterTargetInternal(const FTargetingRequestHandle& TargetingHandle,
+	const APawn* SourcePawn, const AActor* TargetActor, int32& SourceTeamId) const
+{
+	const APawn* TargetPawn = Cast<APawn>(TargetActor);
+	if (!TargetPawn)
+	{
+		return bFilterNonPawns;
+	}
+
+	// Only pay for the team lookups if we filter by attitude
+	if (bFilterFriendly || bFilterNeutral || bFilterHostile)
+	{
+		if (SourceTeamId == INDEX_NONE)
+		{
+			SourceTeamId = GetCachedTeamId(TargetingHandle, SourcePawn);
+		}
+
+		if (ShouldFilterAttitude(static_cast<uint8>(SourceTeamId), GetCachedTeamId(TargetingHandle, TargetPawn)))
+		{
+			return true;
+		}
+	}
+
+	return ShouldIgnorePawn(SourcePawn, TargetPawn);
+}
+
+bool UVigilFilter_PawnRelationship::ShouldIgnorePawn_Implementation(const APawn* SourcePawn,
+	const APawn* TargetPawn) const
+{
+	return false;
+}
+
+APawn* UVigilFilter_PawnRelationship::GetSourcePawn(const FTargetingRequestHandle& TargetingHandle)
+{
+	const FTargetingSourceContext* SourceContext = TargetingHandle.IsValid() ? FTargetingSourceContext::Find(TargetingHandle) : nullptr;
+	if (!SourceContext)
+	{
+		return nullptr;
+	}
+
+	if (APawn* Pawn = Cast<APawn>(SourceContext->SourceActor))
+	{
+		return Pawn;
+	}
+
+	if (const AController* Controller = Cast<AController>(SourceContext->SourceActor))
+	{
+		return Controller->GetPawn();
+	}
+
+	return nullptr;
+}
+
+uint8 UVigilFilter_PawnRelationship::GetCachedTeamId(const FTargetingRequestHandle& TargetingHandle, const APawn* Pawn)
+{
+	FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+	if (const uint8* TeamId = RequestData.TeamIds.Find(FObjectKey(Pawn)))
+	{
+		return *TeamId;
+	}
+
+	// Pawns often leave the team to their controller
+	FGenericTeamId TeamId = FGenericTeamId::GetTeamIdentifier(Pawn);
+	if (TeamId == FGenericTeamId::NoTeam)
+	{
+		TeamId = FGenericTeamId::GetTeamIdentifier(Pawn->GetController());
+	}
+
+	return RequestData.TeamIds.Add(FObjectKey(Pawn), TeamId.GetId());
+}
+
+bool UVigilFilter_PawnRelationship::ShouldFilterAttitude(uint8 SourceTeamId, uint8 TargetTeamId) const
+{
+	switch (FGenericTeamId::GetAttitude(FGenericTeamId(SourceTeamId), FGenericTeamId(TargetTeamId)))
+	{
+	case ETeamAttitude::Friendly: return bFilterFriendly;
+	case ETeamAttitude::Neutral: return bFilterNeutral;
+	case ETeamAttitude::Hostile: return bFilterHostile;
+	default: return false;
+	}
+}
@@ -3,6 +3,8 @@
 
 #include "Sorting/VigilSortBase.h"
 #include "TargetingSystem/TargetingSubsystem.h"
+#include "Targeting/VigilTargetingTypes.h"
+#include "Sorting/VigilSortKeys.h"
 
 #if UE_ENABLE_DEBUG_DRAWING
 #if WITH_EDITORONLY_DATA
@@ -11,10 +13,60 @@
 #endif
 
 #include "Kismet/KismetMathLibrary.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
+#include "VigilTypes.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSortBase)
 
 
+namespace FVigilCVars
+{
+	static float VigilSortCoherenceMaxShifts = 4.f;
+	FAutoConsoleVariableRef CVarVigilSortCoherenceMaxShifts(
+		TEXT("p.Vigil.Sort.CoherenceMaxShifts"),
+		VigilSortCoherenceMaxShifts,
+		TEXT("Sort tasks with bTemporalCoherence fall back to a full sort once the insertion sort has shifted this many keys per target"),
+		ECVF_Default);
+
+	static int32 VigilSortParallelThreshold = 256;
+	FAutoConsoleVariableRef CVarVigilSortParallelThreshold(
+		TEXT("p.Vigil.Sort.ParallelThreshold"),
+		VigilSortParallelThreshold,
+		TEXT("Sort tasks that can score in parallel do so once there are at least this many targets, 0 to disable"),
+		ECVF_Default);
+}
+
+namespace VigilSortStats
+{
+	/** Targets scored by sort tasks */
+	static int64 Evaluated = 0;
+
+	/** Targets that sort tasks didn't score because an earlier sort task pruned them */
+	static int64 Skipped = 0;
+
+	/** Targets pruned by sort tasks */
+	static int64 Pruned = 0;
+
+	static FAutoConsoleCommand CmdCascadeStats(
+		TEXT("p.Vigil.Sort.CascadeStats"),
+		TEXT("Log how many targets Vigil sort tasks scored, and how many they skipped because an earlier sort task pruned them.\n")
+		TEXT("Pass 'reset' to reset the stats"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("reset"), ESearchCase::IgnoreCase))
+			{
+				Evaluated = 0;
+				Skipped = 0;
+				Pruned = 0;
+				return;
+			}
+			const int64 Total = Evaluated + Skipped;
+			UE_LOG(LogVigil, Log, TEXT("Vigil sort cascade: Pruned: %lld Evaluated: %lld Skipped: %lld Evaluations skipped: %.1f%%"),
+				Pruned, Evaluated, Skipped, Total > 0 ? 100.0 * Skipped / Total : 0.0);
+		}));
+}
+
 namespace VigilSortTaskConstants
 {
 	const FString PreSortPrefix = TEXT("PreSort");
@@ -49,44 +101,88 @@ void UVigilSortBase::Execute(const FTargetingRequestHandle& TargetingHandle) con
 #endif
 
 			const int32 NumTargets = ResultData->TargetResults.Num();
+			FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+
+			VigilSortStats::Evaluated += NumTargets;
+			VigilSortStats::Skipped += RequestData ? RequestData->NumPrunedTargets : 0;
+
+			AccumulateScores(TargetingHandle, ResultData->TargetResults);
+
+			// Sort compact (score, index) keys rather than the results, then permute the results once
+			// The request's candidate metrics follow the same order, and both drop anything we prune
+			const FTargetingSourceContext* SourceContext = bTemporalCoherence ? FTargetingSourceContext::Find(TargetingHandle) : nullptr;
+			const FObjectKey SourceKey = SourceContext ? FObjectKey(SourceContext->SourceActor) : FObjectKey();
+			const TArray<FObjectKey>* PreviousOrder = SourceContext ? PreviousOrders.Find(SourceKey) : nullptr;
 
-			// We get the highest score first so we can normalize the score afterwards, 
-			// every task should have the same max score so none weights more than the others
-			float HighestScore = 0.f;
-			TArray<float> RawScores;
-			for (const FTargetingDefaultResultData& TargetResult : ResultData->TargetResults)
+			FVigilSortKeys Keys;
+			const auto AddKeys = [this, &Keys, &ResultData, NumTargets]
 			{
-				const float RawScore = GetScoreForTarget(TargetingHandle, TargetResult);
-				RawScores.Add(RawScore);
-				HighestScore = FMath::Max(HighestScore, RawScore);
+				Keys.Reset(NumTargets);
+				for (int32 TargetIterator = 0; TargetIterator < NumTargets; ++TargetIterator)
+				{
+					const float Score = ResultData->TargetResults[TargetIterator].Score;
+					if (!bPruneByScore || Score <= PruneScore)
+					{
+						Keys.Add(Score, TargetIterator);
+					}
+				}
+			};
+			AddKeys();
+
+			bool bSorted = false;
+			if (PreviousOrder)
+			{
+				bSorted = SortFromPreviousOrder(*PreviousOrder, ResultData->TargetResults, Keys);
+				if (!bSorted)
+				{
+					// The insertion sort gave up part way, start again from index order as radix sorts rely on it to order ties
+					AddKeys();
+				}
 			}
 
-			if(ensureMsgf(NumTargets == RawScores.Num(), TEXT("The cached raw scores should be the same size as the number of targets!")))
+			if (bSorted)
 			{
-				// Adding the normalized scores to each target result.
-				for (int32 TargetIterator = 0; TargetIterator < NumTargets; ++TargetIterator)
+				if (MaxResults > 0 && MaxResults < Keys.Num())
 				{
-					FTargetingDefaultResultData& TargetResult = ResultData->TargetResults[TargetIterator];
-					
-					// Driving ascending/descending sorting based on a multiplier so it carries over to other tasks 
-					const float SortingMultiplier = bAscending ? 1.f : -1.f;
-					TargetResult.Score += UKismetMathLibrary::SafeDivide(RawScores[TargetIterator], HighestScore) * SortingMultiplier;
+					Keys.Keys.SetNum(MaxResults);
 				}
 			}
+			else if (MaxResults > 0 && MaxResults < Keys.Num())
+			{
+				Keys.SelectFirst(MaxResults);
+			}
+			else
+			{
+				Keys.Sort();
+			}
+
+			TArray<int32> Order;
+			Keys.GetOrder(Order);
+
+			if (SourceContext)
+			{
+				StorePreviousOrder(SourceKey, Order, ResultData->TargetResults);
+			}
 
-			auto ByScore = [](const FTargetingDefaultResultData& Lhs, const FTargetingDefaultResultData& Rhs)
+			const bool bPermuteMetrics = RequestData && RequestData->IsAlignedWith(ResultData->TargetResults);
+			if (Order.Num() < NumTargets)
 			{
-				return Lhs.Score < Rhs.Score;
-			};
+				const int32 NumPruned = NumTargets - Order.Num();
+				VigilSortStats::Pruned += NumPruned;
+				FVigilTargetingRequestData::FindOrAdd(TargetingHandle).NumPrunedTargets += NumPruned;
+			}
 
-			// sort the set
-			if (bStableSort)
+			TArray<FTargetingDefaultResultData> SortedResults;
+			SortedResults.Reserve(Order.Num());
+			for (const int32 Index : Order)
 			{
-				ResultData->TargetResults.StableSort(ByScore);
+				SortedResults.Add(MoveTemp(ResultData->TargetResults[Index]));
 			}
-			else
+			ResultData->TargetResults = MoveTemp(SortedResults);
+
+			if (bPermuteMetrics)
 			{
-				ResultData->TargetResults.Sort(ByScore);
+				RequestData->PermuteCandidateMetrics(Order);
 			}
 
 #if UE_ENABLE_DEBUG_DRAWING
@@ -99,6 +195,195 @@ void UVigilSortBase::Execute(const FTargetingRequestHandle& TargetingHandle) con
 }
 
 
+bool UVigilSortBase::SortFromPreviousOrder(const TArray<FObjectKey>& PreviousOrder,
+	const TArray<FTargetingDefaultResultData>& TargetResults, FVigilSortKeys& Keys) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortBase::SortFromPreviousOrder);
+
+	TMap<FObjectKey, int32> PreviousRanks;
+	PreviousRanks.Reserve(PreviousOrder.Num());
+	for (int32 Rank = 0; Rank < PreviousOrder.Num(); ++Rank)
+	{
+		PreviousRanks.Add(PreviousOrder[Rank], Rank);
+	}
+
+	// Place each target where it was last time, anything new goes last
+	static constexpr uint64 EmptySlot = MAX_uint64;
+	TArray<uint64> Slots;
+	Slots.Init(EmptySlot, PreviousOrder.Num());
+	TArray<uint64> NewKeys;
+	for (const uint64 Key : Keys.Keys)
+	{
+		const FTargetingDefaultResultData& TargetData = TargetResults[static_cast<int32>(Key & 0xFFFFFFFF)];
+		const int32* Rank = PreviousRanks.Find(FVigilTargetingRequestData::GetCandidateKey(TargetData));
+		if (Rank && Slots[*Rank] == EmptySlot)
+		{
+			Slots[*Rank] = Key;
+		}
+		else
+		{
+			NewKeys.Add(Key);
+		}
+	}
+
+	Keys.Keys.Reset();
+	for (const uint64 Key : Slots)
+	{
+		if (Key != EmptySlot)
+		{
+			Keys.Keys.Add(Key);
+		}
+	}
+	Keys.Keys.Append(NewKeys);
+
+	const int32 MaxShifts = FMath::CeilToInt32(Keys.Num() * FMath::Max(0.f, FVigilCVars::VigilSortCoherenceMaxShifts));
+	return Keys.InsertionSort(MaxShifts);
+}
+
+void UVigilSortBase::StorePreviousOrder(const FObjectKey& SourceKey, const TArray<int32>& Order,
+	const TArray<FTargetingDefaultResultData>& TargetResults) const
+{
+	// Forget sources that no longer exist
+	if (PreviousOrders.Num() >= 64 && !PreviousOrders.Contains(SourceKey))
+	{
+		for (auto It = PreviousOrders.CreateIterator(); It; ++It)
+		{
+			if (!It.Key().ResolveObjectPtr())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	TArray<FObjectKey>& PreviousOrder = PreviousOrders.FindOrAdd(SourceKey);
+	PreviousOrder.Reset(Order.Num());
+	for (const int32 Index : Order)
+	{
+		PreviousOrder.Add(FVigilTargetingRequestData::GetCandidateKey(TargetResults[Index]));
+	}
+}
+
+void UVigilSortBase::AccumulateScores(const FTargetingRequestHandle& TargetingHandle,
+	TArray<FTargetingDefaultResultData>& TargetResults) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortBase::AccumulateScores);
+
+	const int32 NumTargets = TargetResults.Num();
+
+	// We get the highest score first so we can normalize the score afterwards, 
+	// every task should have the same max score so none weights more than the others
+	float HighestScore = 0.f;
+	TArray<float> RawScores;
+	GetRawScores(TargetingHandle, TargetResults, RawScores);
+
+	for (const float RawScore : RawScores)
+	{
+		HighestScore = FMath::Max(HighestScore, RawScore);
+	}
+
+	if(ensureMsgf(NumTargets == RawScores.Num(), TEXT("The cached raw scores should be the same size as the number of targets!")))
+	{
+		// Adding the normalized scores to each target result.
+		for (int32 TargetIterator = 0; TargetIterator < NumTargets; ++TargetIterator)
+		{
+			FTargetingDefaultResultData& TargetResult = TargetResults[TargetIterator];
+			
+			// Driving ascending/descending sorting based on a multiplier so it carries over to other tasks 
+			const float SortingMultiplier = bAscending ? 1.f : -1.f;
+			TargetResult.Score += UKismetMathLibrary::SafeDivide(RawScores[TargetIterator], HighestScore) * SortingMultiplier;
+		}
+	}
+}
+
+float UVigilSortBase::ScoreTarget(const FTargetingRequestHandle& TargetingHandle,
+	const FTargetingDefaultResultData& TargetData) const
+{
+	return IsScoreForTargetImplementedInScript() ? GetScoreForTarget(TargetingHandle, TargetData) :
+		GetScoreForTarget_Implementation(TargetingHandle, TargetData);
+}
+
+void UVigilSortBase::GetRawScores(const FTargetingRequestHandle& TargetingHandle,
+	const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortBase::GetRawScores);
+
+	// Only pay for the reflection call if a Blueprint overrides it
+	OutScores.Reset(TargetResults.Num());
+	if (GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UVigilSortBase, GetScoresForTargets)))
+	{
+		GetScoresForTargets(TargetingHandle, TargetResults, OutScores);
+	}
+	else
+	{
+		GetScoresForTargets_Implementation(TargetingHandle, TargetResults, OutScores);
+	}
+
+	if (!ensureMsgf(OutScores.Num() == TargetResults.Num(), TEXT("%s GetScoresForTargets must return a score for each target"), *GetNameSafe(this)))
+	{
+		OutScores.SetNumZeroed(TargetResults.Num());
+	}
+}
+
+void UVigilSortBase::GetScoresForTargets_Implementation(const FTargetingRequestHandle& TargetingHandle,
+	const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const
+{
+	if (ScoreTargets(TargetingHandle, TargetResults, OutScores) && OutScores.Num() == TargetResults.Num())
+	{
+		return;
+	}
+
+	// Only pay for the reflection call for each target if a Blueprint overrides it
+	const bool bScript = IsScoreForTargetImplementedInScript();
+	const int32 NumTargets = TargetResults.Num();
+	if (!bScript && CanScoreInParallel() && FVigilCVars::VigilSortParallelThreshold > 0 &&
+		NumTargets >= FVigilCVars::VigilSortParallelThreshold)
+	{
+		TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortBase::GetScoresForTargets_Parallel);
+
+		PrepareParallelScoring(TargetingHandle);
+
+		// Each score only depends on its own target, so the order matches the serial path
+		OutScores.SetNumUninitialized(NumTargets);
+		ParallelFor(NumTargets, [this, &TargetingHandle, &TargetResults, &OutScores](int32 TargetIndex)
+		{
+			OutScores[TargetIndex] = GetScoreForTarget_Implementation(TargetingHandle, TargetResults[TargetIndex]);
+		});
+		return;
+	}
+
+	OutScores.Reset(NumTargets);
+	for (const FTargetingDefaultResultData& TargetResult : TargetResults)
+	{
+		OutScores.Add(bScript ? GetScoreForTarget(TargetingHandle, TargetResult) :
+			GetScoreForTarget_Implementation(TargetingHandle, TargetResult));
+	}
+}
+
+void UVigilSortBase::PrepareParallelScoring(const FTargetingRequestHandle& TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortBase::PrepareParallelScoring);
+
+	// Looking up metrics realigns them and computes angles on demand, do that now so the workers only read them
+	FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	const FTargetingDefaultResultsSet* Results = FTargetingDefaultResultsSet::Find(TargetingHandle);
+	if (RequestData && RequestData->bValid && Results)
+	{
+		if (!RequestData->IsAlignedWith(Results->TargetResults))
+		{
+			RequestData->SyncCandidateMetrics(Results->TargetResults);
+		}
+		for (FVigilTargetMetrics& Metrics : RequestData->CandidateMetrics)
+		{
+			RequestData->EnsureAngle(Metrics);
+		}
+	}
+}
+
+bool UVigilSortBase::IsScoreForTargetImplementedInScript() const
+{
+	return GetClass()->IsFunctionImplementedInScript(GET_FUNCTION_NAME_CHECKED(UVigilSortBase, GetScoreForTarget));
+}
+
 #if UE_ENABLE_DEBUG_DRAWING
 
 void UVigilSortBase::DrawDebug(UTargetingSubsystem* TargetingSubsystem, FTargetingDebugInfo& Info, const FTargetingRequestHandle& TargetingHandle, float XOffset, float YOffset, int32 MinTextRowsToAdvance) const
@@ -0,0 +1,203 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Sorting/VigilSortKeys.h"
+
+#include "HAL/IConsoleManager.h"
+#include "Algo/Sort.h"
+#include "System/VigilVersioning.h"
+
+#if !UE_BUILD_SHIPPING
+#include "VigilTypes.h"
+#include "Math/RandomStream.h"
+#include "HAL/PlatformTime.h"
+#endif
+
+namespace FVigilCVars
+{
+	static int32 VigilSortRadixThreshold = 256;
+	FAutoConsoleVariableRef CVarVigilSortRadixThreshold(
+		TEXT("p.Vigil.Sort.RadixThreshold"),
+		VigilSortRadixThreshold,
+		TEXT("Sort tasks radix sort their targets when there are at least this many, otherwise use a comparison sort.\n")
+		TEXT("Use p.Vigil.Sort.Benchmark to find the crossover for your platform. 0 to never radix sort"),
+		ECVF_Default);
+}
+
+void FVigilSortKeys::Sort()
+{
+	const int32 Threshold = FVigilCVars::VigilSortRadixThreshold;
+	if (Threshold > 0 && Keys.Num() >= Threshold)
+	{
+		RadixSort();
+	}
+	else
+	{
+		ComparisonSort();
+	}
+}
+
+void FVigilSortKeys::ComparisonSort()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortKeys::ComparisonSort);
+
+	// Keys are unique so this is stable
+	Algo::Sort(Keys);
+}
+
+void FVigilSortKeys::RadixSort()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortKeys::RadixSort);
+
+	// Least significant digit first over the score's 32 bits in 3 passes of 11 bits
+	// Each pass is stable, and keys are added in index order, so ties stay in index order
+	static constexpr int32 NumBits = 11;
+	static constexpr int32 NumBuckets = 1 << NumBits;
+	static constexpr uint64 Mask = NumBuckets - 1;
+
+	const int32 NumKeys = Keys.Num();
+	TArray<uint64> Scratch;
+	Scratch.SetNumUninitialized(NumKeys);
+
+	uint64* Src = Keys.GetData();
+	uint64* Dst = Scratch.GetData();
+	TArray<int32> Offsets;
+	Offsets.SetNumUninitialized(NumBuckets);
+	for (int32 Shift = 32; Shift < 64; Shift += NumBits)
+	{
+		FMemory::Memzero(Offsets.GetData(), NumBuckets * sizeof(int32));
+		for (int32 KeyIndex = 0; KeyIndex < NumKeys; ++KeyIndex)
+		{
+			Offsets[(Src[KeyIndex] >> Shift) & Mask]++;
+		}
+
+		int32 Offset = 0;
+		for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+		{
+			const int32 Count = Offsets[Bucket];
+			Offsets[Bucket] = Offset;
+			Offset += Count;
+		}
+
+		for (int32 KeyIndex = 0; KeyIndex < NumKeys; ++KeyIndex)
+		{
+			Dst[Offsets[(Src[KeyIndex] >> Shift) & Mask]++] = Src[KeyIndex];
+		}
+
+		Swap(Src, Dst);
+	}
+
+	// An odd number of passes leaves the result in the scratch buffer
+	if (Src != Keys.GetData())
+	{
+		Keys = MoveTemp(Scratch);
+	}
+}
+
+void FVigilSortKeys::SelectFirst(int32 NumToKeep)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortKeys::SelectFirst);
+
+	if (NumToKeep >= Keys.Num())
+	{
+		Sort();
+		return;
+	}
+
+	TArray<uint64> Selected;
+	Selected.Reserve(NumToKeep);
+
+	// Heapify is linear, then each pop is logarithmic, so only the kept keys are sorted
+	Keys.Heapify();
+	for (int32 Position = 0; Position < NumToKeep; ++Position)
+	{
+		uint64& Key = Selected.AddDefaulted_GetRef();
+#if UE_5_04_OR_LATER
+		Keys.HeapPop(Key, EAllowShrinking::No);
+#else
+		Keys.HeapPop(Key, false);
+#endif
+	}
+	Keys = MoveTemp(Selected);
+}
+
+bool FVigilSortKeys::InsertionSort(int32 MaxShifts)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSortKeys::InsertionSort);
+
+	int32 NumShifts = 0;
+	uint64* Data = Keys.GetData();
+	for (int32 KeyIndex = 1; KeyIndex < Keys.Num(); ++KeyIndex)
+	{
+		const uint64 Key = Data[KeyIndex];
+		int32 Position = KeyIndex;
+		while (Position > 0 && Data[Position - 1] > Key)
+		{
+			Data[Position] = Data[Position - 1];
+			--Position;
+		}
+
+		Data[Position] = Key;
+		NumShifts += KeyIndex - Position;
+		if (NumShifts > MaxShifts)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FVigilSortKeys::GetOrder(TArray<int32>& OutOrder) const
+{
+	OutOrder.SetNumUninitialized(Keys.Num());
+	for (int32 Position = 0; Position < Keys.Num(); ++Position)
+	{
+		OutOrder[Position] = GetIndex(Position);
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+namespace VigilSortBenchmark
+{
+	static FAutoConsoleCommand CmdSortBenchmark(
+		TEXT("p.Vigil.Sort.Benchmark"),
+		TEXT("Log how long comparison and radix sorts of Vigil sort keys take for a range of target counts, to find p.Vigil.Sort.RadixThreshold.\n")
+		TEXT("Optionally pass the number of iterations for each count"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			const int32 NumIterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+
+			FRandomStream Stream(1234);
+			FVigilSortKeys Unsorted;
+			FVigilSortKeys Keys;
+			for (const int32 NumKeys : { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 })
+			{
+				Unsorted.Reset(NumKeys);
+				for (int32 KeyIndex = 0; KeyIndex < NumKeys; ++KeyIndex)
+				{
+					Unsorted.Add(Stream.FRandRange(-1.f, 1.f), KeyIndex);
+				}
+
+				double ComparisonTime = 0.0;
+				double RadixTime = 0.0;
+				for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+				{
+					Keys = Unsorted;
+					double StartTime = FPlatformTime::Seconds();
+					Keys.ComparisonSort();
+					ComparisonTime += FPlatformTime::Seconds() - StartTime;
+
+					Keys = Unsorted;
+					StartTime = FPlatformTime::Seconds();
+					Keys.RadixSort();
+					RadixTime += FPlatformTime::Seconds() - StartTime;
+				}
+
+				const double ComparisonUs = ComparisonTime * 1e6 / NumIterations;
+				const double RadixUs = RadixTime * 1e6 / NumIterations;
+				UE_LOG(LogVigil, Log, TEXT("Vigil sort benchmark: Targets: %d Comparison: %.2fus Radix: %.2fus %s"),
+					NumKeys, ComparisonUs, RadixUs, RadixUs < ComparisonUs ? TEXT("(radix faster)") : TEXT(""));
+			}
+		}));
+}
+#endif
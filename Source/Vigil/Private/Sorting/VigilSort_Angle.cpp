@@ -4,7 +4,7 @@
 #include "Sorting/VigilSort_Angle.h"
 
 #include "TargetingSystem/TargetingSubsystem.h"
-#include "VigilStatics.h"
+#include "Targeting/VigilTargetingStatics.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_Angle)
 
@@ -14,7 +14,10 @@ float UVigilSort_Angle::GetScoreForTarget_Implementation(const FTargetingRequest
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_Angle::GetScoreForTarget);
 	
-	float Score, Max;
-	UVigilStatics::GetAngleToVigilTarget(TargetData.HitResult, Score, Max);
-	return Score;
+	if (bCosineScore)
+	{
+		static constexpr bool bNeedAngle = false;
+		return 1.f - UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData, bNeedAngle).AngleCos;
+	}
+	return UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData).NormalizedAngle;
 }
@@ -4,7 +4,7 @@
 #include "Sorting/VigilSort_AverageAngleDistance.h"
 
 #include "TargetingSystem/TargetingSubsystem.h"
-#include "VigilStatics.h"
+#include "Targeting/VigilTargetingStatics.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_AverageAngleDistance)
 
@@ -14,8 +14,6 @@ float UVigilSort_AverageAngleDistance::GetScoreForTarget_Implementation(const FT
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_AverageAngleDistance::GetScoreForTarget);
 	
-	float Dist, Angle, Max;
-	UVigilStatics::GetDistanceToVigilTarget(TargetData.HitResult, Dist, Max);
-	UVigilStatics::GetAngleToVigilTarget(TargetData.HitResult, Angle, Max);
-	return 0.5f * (Dist + Angle);
+	const FVigilTargetMetrics Metrics = UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData);
+	return 0.5f * (Metrics.NormalizedDistance + Metrics.NormalizedAngle);
 }
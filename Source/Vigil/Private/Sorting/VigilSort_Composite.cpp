@@ -0,0 +1,111 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Sorting/VigilSort_Composite.h"
+
+#include "TargetingSystem/TargetingSubsystem.h"
+#include "Targeting/VigilTargetingStatics.h"
+#include "Kismet/KismetMathLibrary.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_Composite)
+
+
+void UVigilSort_Composite::AccumulateScores(const FTargetingRequestHandle& TargetingHandle,
+	TArray<FTargetingDefaultResultData>& TargetResults) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_Composite::AccumulateScores);
+
+	const int32 NumTargets = TargetResults.Num();
+	const int32 NumCriteria = Criteria.Num();
+	if (NumTargets == 0 || NumCriteria == 0)
+	{
+		return;
+	}
+
+	// Resolve anything shared by every target once
+	bool bNeedAngle = false;
+	bool bNeedMetrics = false;
+	bool bNeedScreen = false;
+	for (const FVigilSortCriterion& Criterion : Criteria)
+	{
+		bNeedAngle |= Criterion.Criterion == EVigilSortCriterion::Angle && !Criterion.bCosineScore;
+		bNeedMetrics |= Criterion.Criterion == EVigilSortCriterion::Angle || Criterion.Criterion == EVigilSortCriterion::Distance;
+		bNeedScreen |= Criterion.Criterion == EVigilSortCriterion::ScreenDistance;
+	}
+
+	const FVigilScreenProjection* ScreenProjection = bNeedScreen ?
+		&UVigilSort_ScreenDistance::GetScreenProjection(TargetingHandle) : nullptr;
+
+	// Raw scores for each criterion, laid out per criterion so each can be normalized by its own highest score
+	TArray<float> RawScores;
+	RawScores.SetNumZeroed(NumTargets * NumCriteria);
+	TArray<float> HighestScores;
+	HighestScores.SetNumZeroed(NumCriteria);
+
+	// Custom scorers score every target in a single call
+	TArray<float> CustomScores;
+	for (int32 CriterionIterator = 0; CriterionIterator < NumCriteria; ++CriterionIterator)
+	{
+		const FVigilSortCriterion& Criterion = Criteria[CriterionIterator];
+		if (Criterion.Criterion == EVigilSortCriterion::Custom && Criterion.Scorer && Criterion.Weight > 0.f)
+		{
+			Criterion.Scorer->GetRawScores(TargetingHandle, TargetResults, CustomScores);
+			FMemory::Memcpy(&RawScores[CriterionIterator * NumTargets], CustomScores.GetData(), NumTargets * sizeof(float));
+		}
+	}
+
+	for (int32 TargetIterator = 0; TargetIterator < NumTargets; ++TargetIterator)
+	{
+		const FTargetingDefaultResultData& TargetData = TargetResults[TargetIterator];
+		const FVigilTargetMetrics Metrics = bNeedMetrics ?
+			UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData, bNeedAngle) : FVigilTargetMetrics();
+
+		for (int32 CriterionIterator = 0; CriterionIterator < NumCriteria; ++CriterionIterator)
+		{
+			const FVigilSortCriterion& Criterion = Criteria[CriterionIterator];
+			if (Criterion.Weight <= 0.f)
+			{
+				continue;
+			}
+
+			float RawScore = 0.f;
+			switch (Criterion.Criterion)
+			{
+			case EVigilSortCriterion::Angle:
+				RawScore = Criterion.bCosineScore ? 1.f - Metrics.AngleCos : Metrics.NormalizedAngle;
+				break;
+			case EVigilSortCriterion::Distance:
+				RawScore = Metrics.NormalizedDistance;
+				break;
+			case EVigilSortCriterion::ScreenDistance:
+				RawScore = ScreenProjection ? UVigilSort_ScreenDistance::GetScreenDistanceToTarget(*ScreenProjection, TargetData, Criterion.LocationSource) : 0.f;
+				break;
+			case EVigilSortCriterion::Custom:
+				RawScore = RawScores[CriterionIterator * NumTargets + TargetIterator];
+				break;
+			}
+
+			RawScores[CriterionIterator * NumTargets + TargetIterator] = RawScore;
+			HighestScores[CriterionIterator] = FMath::Max(HighestScores[CriterionIterator], RawScore);
+		}
+	}
+
+	// Normalize and weight each criterion, then add to the target's score
+	const float SortingMultiplier = bAscending ? 1.f : -1.f;
+	for (int32 CriterionIterator = 0; CriterionIterator < NumCriteria; ++CriterionIterator)
+	{
+		const FVigilSortCriterion& Criterion = Criteria[CriterionIterator];
+		if (Criterion.Weight <= 0.f)
+		{
+			continue;
+		}
+
+		const float CriterionMultiplier = Criterion.Weight * (Criterion.bAscending ? 1.f : -1.f) * SortingMultiplier;
+		const float HighestScore = HighestScores[CriterionIterator];
+		const float* CriterionScores = &RawScores[CriterionIterator * NumTargets];
+		for (int32 TargetIterator = 0; TargetIterator < NumTargets; ++TargetIterator)
+		{
+			TargetResults[TargetIterator].Score += UKismetMathLibrary::SafeDivide(CriterionScores[TargetIterator], HighestScore) * CriterionMultiplier;
+		}
+	}
+}
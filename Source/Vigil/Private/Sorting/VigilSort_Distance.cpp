@@ -4,7 +4,7 @@
 #include "Sorting/VigilSort_Distance.h"
 
 #include "TargetingSystem/TargetingSubsystem.h"
-#include "VigilStatics.h"
+#include "Targeting/VigilTargetingStatics.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_Distance)
 
@@ -14,7 +14,6 @@ float UVigilSort_Distance::GetScoreForTarget_Implementation(const FTargetingRequ
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_ScreenDistance::GetScoreForTarget);
 
-	float Score, Max;
-	UVigilStatics::GetDistanceToVigilTarget(TargetData.HitResult, Score, Max);
-	return Score;
+	static constexpr bool bNeedAngle = false;
+	return UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData, bNeedAngle).NormalizedDistance;
 }
@@ -3,13 +3,14 @@
 
 #include "Sorting/VigilSort_ScreenDistance.h"
 
-#include "Blueprint/WidgetLayoutLibrary.h"
-#include "Kismet/GameplayStatics.h"
-#include "TargetingSystem/TargetingSubsystem.h"
-#include "Targeting/VigilTargetingStatics.h"
+#include "Targeting/VigilTargetingTypes.h"
 #include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/Pawn.h"
 #include "Components/PrimitiveComponent.h"
-#include "Engine/World.h"
+#include "Engine/GameViewportClient.h"
+#include "Engine/LocalPlayer.h"
+#include "SceneView.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_ScreenDistance)
 
@@ -24,35 +25,129 @@ float UVigilSort_ScreenDistance::GetScoreForTarget_Implementation(const FTargeti
 
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_ScreenDistance::GetScoreForTarget);
 
-	const UTargetingSubsystem* TargetSubsystem = GetTargetingSubsystem(TargetingHandle);
-	if (APlayerController* PC = TargetSubsystem ? UGameplayStatics::GetPlayerController(TargetSubsystem->GetWorld(), 0) : nullptr)
+	return GetScreenDistanceToTarget(GetScreenProjection(TargetingHandle), TargetData, LocationSource);
+}
+
+bool UVigilSort_ScreenDistance::ScoreTargets(const FTargetingRequestHandle& TargetingHandle,
+	const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const
+{
+	if (IsRunningDedicatedServer() || IsScoreForTargetImplementedInScript())
+	{
+		return false;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_ScreenDistance::ScoreTargets);
+
+	GetScreenDistancesToTargets(GetScreenProjection(TargetingHandle), TargetResults, LocationSource, OutScores);
+	return true;
+}
+
+APlayerController* UVigilSort_ScreenDistance::GetSourcePlayerController(const FTargetingRequestHandle& TargetingHandle)
+{
+	const FTargetingSourceContext* SourceContext = TargetingHandle.IsValid() ? FTargetingSourceContext::Find(TargetingHandle) : nullptr;
+	if (!SourceContext)
+	{
+		return nullptr;
+	}
+
+	for (AActor* Actor : { SourceContext->SourceActor.Get(), SourceContext->InstigatorActor.Get() })
 	{
-		// Determine location to project to screen
-		FVector WorldLocation = TargetData.HitResult.Location;
-		if (LocationSource == EVigilScreenDistanceLocationSource::HitActor)
+		APlayerController* PC = Cast<APlayerController>(Actor);
+		if (!PC)
 		{
-			WorldLocation = TargetData.HitResult.GetActor()->GetActorLocation();
+			if (const APawn* Pawn = Cast<APawn>(Actor))
+			{
+				PC = Pawn->GetController<APlayerController>();
+			}
+			else if (const APlayerState* PlayerState = Cast<APlayerState>(Actor))
+			{
+				PC = PlayerState->GetPlayerController();
+			}
 		}
-		else if (LocationSource == EVigilScreenDistanceLocationSource::HitComponent)
+
+		if (PC && PC->IsLocalController())
 		{
-			WorldLocation = TargetData.HitResult.GetComponent()->GetComponentLocation();
+			return PC;
 		}
+	}
+	return nullptr;
+}
 
-		// Project to screen
-		FVector2D ScreenLocation;
-		if (!PC->ProjectWorldLocationToScreen(WorldLocation, ScreenLocation, true))
+const FVigilScreenProjection& UVigilSort_ScreenDistance::GetScreenProjection(const FTargetingRequestHandle& TargetingHandle)
+{
+	FVigilScreenProjection& Projection = FVigilTargetingRequestData::FindOrAdd(TargetingHandle).ScreenProjection;
+	if (Projection.bResolved)
+	{
+		return Projection;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_ScreenDistance::GetScreenProjection);
+
+	Projection.bResolved = true;
+	if (IsRunningDedicatedServer())
+	{
+		return Projection;
+	}
+
+	const APlayerController* PC = GetSourcePlayerController(TargetingHandle);
+	const ULocalPlayer* LocalPlayer = PC ? PC->GetLocalPlayer() : nullptr;
+	if (LocalPlayer && LocalPlayer->ViewportClient)
+	{
+		FSceneViewProjectionData ProjectionData;
+		if (LocalPlayer->GetProjectionData(LocalPlayer->ViewportClient->Viewport, ProjectionData))
 		{
-			return 0.f;
+			Projection.ViewProjectionMatrix = ProjectionData.ComputeViewProjectionMatrix();
+			Projection.ViewRect = ProjectionData.GetConstrainedViewRect();
+			Projection.bValid = true;
 		}
-		
-		// Get screen size
-		const FGeometry Geometry = UWidgetLayoutLibrary::GetViewportWidgetGeometry(PC);
-		const FVector2D Size = Geometry.GetAbsoluteSize();
-		const FVector2D Center = Size * 0.5f;
+	}
+	return Projection;
+}
+
+FVector UVigilSort_ScreenDistance::GetTargetWorldLocation(const FTargetingDefaultResultData& TargetData,
+	EVigilScreenDistanceLocationSource LocationSource)
+{
+	switch (LocationSource)
+	{
+	case EVigilScreenDistanceLocationSource::HitActor: return TargetData.HitResult.GetActor()->GetActorLocation();
+	case EVigilScreenDistanceLocationSource::HitComponent: return TargetData.HitResult.GetComponent()->GetComponentLocation();
+	default: return TargetData.HitResult.Location;
+	}
+}
+
+float UVigilSort_ScreenDistance::GetScreenDistanceToTarget(const FVigilScreenProjection& Projection,
+	const FTargetingDefaultResultData& TargetData, EVigilScreenDistanceLocationSource LocationSource)
+{
+	// Project to screen
+	FVector2D ScreenLocation;
+	if (!Projection.Project(GetTargetWorldLocation(TargetData, LocationSource), ScreenLocation))
+	{
+		return 0.f;
+	}
+
+	// Calculate distance
+	return FVector2D::Distance(Projection.GetScreenCenter(), ScreenLocation);
+}
+
+void UVigilSort_ScreenDistance::GetScreenDistancesToTargets(const FVigilScreenProjection& Projection,
+	const TArray<FTargetingDefaultResultData>& TargetResults, EVigilScreenDistanceLocationSource LocationSource,
+	TArray<float>& OutDistances)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_ScreenDistance::GetScreenDistancesToTargets);
 
-		// Calculate distance
-		return FVector2D::Distance(Center, ScreenLocation);
+	OutDistances.SetNumZeroed(TargetResults.Num());
+	if (!Projection.bValid)
+	{
+		return;
 	}
 
-	return 0.f;
+	const FVector2D ScreenCenter = Projection.GetScreenCenter();
+	for (int32 TargetIndex = 0; TargetIndex < TargetResults.Num(); ++TargetIndex)
+	{
+		FVector2D ScreenLocation;
+		if (Projection.Project(GetTargetWorldLocation(TargetResults[TargetIndex], LocationSource), ScreenLocation))
+		{
+			OutDistances[TargetIndex] = FVector2D::Distance(ScreenCenter, ScreenLocation);
+		}
+	}
 }
@@ -4,7 +4,7 @@
 #include "Sorting/VigilSort_WeightedAngleDistance.h"
 
 #include "TargetingSystem/TargetingSubsystem.h"
-#include "VigilStatics.h"
+#include "Targeting/VigilTargetingStatics.h"
 
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilSort_WeightedAngleDistance)
 
@@ -14,10 +14,8 @@ float UVigilSort_WeightedAngleDistance::GetScoreForTarget_Implementation(const F
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilSort_WeightedAngleDistance::GetScoreForTarget);
 	
-	float Dist, Angle, Max;
-	UVigilStatics::GetDistanceToVigilTarget(TargetData.HitResult, Dist, Max);
-	UVigilStatics::GetAngleToVigilTarget(TargetData.HitResult, Angle, Max);
-	const float AngleScore = Angle * AngleWeight;
-	const float DistanceScore = Dist * (1.f - AngleWeight);
+	const FVigilTargetMetrics Metrics = UVigilTargetingStatics::GetVigilTargetMetrics(TargetingHandle, TargetData);
+	const float AngleScore = Metrics.NormalizedAngle * AngleWeight;
+	const float DistanceScore = Metrics.NormalizedDistance * (1.f - AngleWeight);
 	return AngleScore + DistanceScore;
 }
@@ -0,0 +1,213 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "System/VigilBroadphaseBatcher.h"
+
+#include "VigilTypes.h"
+#include "Targeting/VigilTargetSelection.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/OverlapResult.h"
+#include "HAL/IConsoleManager.h"
+#include "DrawDebugHelpers.h"
+#include "Algo/Sort.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilBroadphaseBatcher)
+
+namespace FVigilCVars
+{
+	static bool bVigilBroadphaseEnabled = true;
+	FAutoConsoleVariableRef CVarVigilBroadphaseEnabled(
+		TEXT("p.Vigil.Broadphase.Enable"),
+		bVigilBroadphaseEnabled,
+		TEXT("If true, selections with bShareBroadphase group nearby requests into a single overlap"),
+		ECVF_Default);
+
+	static float VigilBroadphaseClusterRadius = 600.f;
+	FAutoConsoleVariableRef CVarVigilBroadphaseClusterRadius(
+		TEXT("p.Vigil.Broadphase.ClusterRadius"),
+		VigilBroadphaseClusterRadius,
+		TEXT("Requests whose shapes are centered within this distance of a group's first request join the group"),
+		ECVF_Default);
+
+	static int32 VigilBroadphaseMaxGroupSize = 32;
+	FAutoConsoleVariableRef CVarVigilBroadphaseMaxGroupSize(
+		TEXT("p.Vigil.Broadphase.MaxGroupSize"),
+		VigilBroadphaseMaxGroupSize,
+		TEXT("Maximum number of requests that can share a single overlap"),
+		ECVF_Default);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	static bool bVigilBroadphaseDebug = false;
+	FAutoConsoleVariableRef CVarVigilBroadphaseDebug(
+		TEXT("p.Vigil.Broadphase.Debug"),
+		bVigilBroadphaseDebug,
+		TEXT("If true, print Vigil broadphase batcher stats to screen and draw shared overlaps"),
+		ECVF_Default);
+#endif
+}
+
+UVigilBroadphaseBatcher* UVigilBroadphaseBatcher::Get(const UWorld* World)
+{
+	if (!FVigilCVars::bVigilBroadphaseEnabled || !IsValid(World))
+	{
+		return nullptr;
+	}
+	return World->GetSubsystem<UVigilBroadphaseBatcher>();
+}
+
+void UVigilBroadphaseBatcher::AddRequest(const UVigilTargetSelection* Selection,
+	const FTargetingRequestHandle& TargetingHandle, const FVector& Location, const FQuat& Rotation, float Radius)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilBroadphaseBatcher::AddRequest);
+	
+	PendingRequests.Emplace(Selection, TargetingHandle, Location, Rotation, Radius);
+}
+
+bool UVigilBroadphaseBatcher::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UVigilBroadphaseBatcher::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilBroadphaseBatcher::Tick);
+
+	NumQueriesLastFrame = 0;
+	NumRequestsLastFrame = 0;
+
+	if (PendingRequests.Num() == 0)
+	{
+		return;
+	}
+
+	// New requests can be added by the completion of others, take what we have now
+	TArray<FVigilBroadphaseRequest> Requests = MoveTemp(PendingRequests);
+	PendingRequests.Reset();
+
+	// Keep same-task requests adjacent so grouping only considers compatible requests
+	Algo::SortBy(Requests, [](const FVigilBroadphaseRequest& Request) { return Request.Selection.Get(); });
+
+	const float ClusterRadiusSq = FMath::Square(FVigilCVars::VigilBroadphaseClusterRadius);
+	const int32 MaxGroupSize = FMath::Max(1, FVigilCVars::VigilBroadphaseMaxGroupSize);
+
+	TBitArray<> Grouped(false, Requests.Num());
+	for (int32 i = 0; i < Requests.Num(); i++)
+	{
+		if (Grouped[i])
+		{
+			continue;
+		}
+
+		const FVigilBroadphaseRequest& Seed = Requests[i];
+		const UVigilTargetSelection* Selection = Seed.Selection.Get();
+		if (!Selection || !IsRequestValid(Seed))
+		{
+			continue;
+		}
+
+		// Greedily gather the requests around the seed
+		TArray<FVigilBroadphaseRequest> Members;
+		Members.Add(Seed);
+		Grouped[i] = true;
+		for (int32 j = i + 1; j < Requests.Num() && Members.Num() < MaxGroupSize; j++)
+		{
+			if (Requests[j].Selection.Get() != Selection)
+			{
+				break;
+			}
+
+			if (!Grouped[j] && FVector::DistSquared(Seed.Center, Requests[j].Center) <= ClusterRadiusSq && IsRequestValid(Requests[j]))
+			{
+				Members.Add(Requests[j]);
+				Grouped[j] = true;
+			}
+		}
+
+		NumRequestsLastFrame += Members.Num();
+		StartGroupOverlap(Selection, MoveTemp(Members));
+	}
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilBroadphaseDebug && GEngine)
+	{
+		const int32 UniqueKey = (GetUniqueID() + 313) % INT32_MAX;
+		const FString Info = FString::Printf(TEXT("Vigil Broadphase: Requests: %d Queries: %d"),
+			NumRequestsLastFrame, NumQueriesLastFrame);
+		GEngine->AddOnScreenDebugMessage(UniqueKey, 1.f, FColor::Green, Info);
+	}
+#endif
+}
+
+void UVigilBroadphaseBatcher::StartGroupOverlap(const UVigilTargetSelection* Selection,
+	TArray<FVigilBroadphaseRequest>&& Members)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilBroadphaseBatcher::StartGroupOverlap);
+
+	NumQueriesLastFrame++;
+
+	// Nobody nearby to share with, our own shape is tighter than an enclosing sphere
+	if (Members.Num() == 1)
+	{
+		const FVigilBroadphaseRequest& Member = Members[0];
+		Selection->StartOwnAsyncOverlap(GetWorld(), Member.TargetingHandle, Member.Center, Member.Rotation);
+		return;
+	}
+
+	// Find the sphere that encloses every member's shape
+	FVector Center = FVector::ZeroVector;
+	for (const FVigilBroadphaseRequest& Member : Members)
+	{
+		Center += Member.Center;
+	}
+	Center /= Members.Num();
+
+	float Radius = 0.f;
+	for (const FVigilBroadphaseRequest& Member : Members)
+	{
+		Radius = FMath::Max(Radius, FVector::Dist(Center, Member.Center) + Member.Radius);
+	}
+
+	// Members apply their own ignored actors when testing the shared candidates
+	const FCollisionQueryParams OverlapParams(TEXT("UVigilBroadphaseBatcher"), SCENE_QUERY_STAT_ONLY(UVigilBroadphaseBatcher),
+		Selection->IsTraceComplex());
+
+	UE_LOG(LogVigil, VeryVerbose, TEXT("VigilBroadphaseBatcher: Shared overlap for %d requests using %s, radius %.1f"),
+		Members.Num(), *GetNameSafe(Selection), Radius);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilBroadphaseDebug)
+	{
+		DrawDebugSphere(GetWorld(), Center, Radius, 24, FColor::Cyan, false, 0.f);
+	}
+#endif
+
+	const FOverlapDelegate Delegate = FOverlapDelegate::CreateUObject(this, &ThisClass::HandleGroupOverlapComplete, MoveTemp(Members));
+	Selection->StartAsyncOverlap(GetWorld(), Center, FQuat::Identity, FCollisionShape::MakeSphere(Radius), OverlapParams, Delegate);
+}
+
+void UVigilBroadphaseBatcher::HandleGroupOverlapComplete(const FTraceHandle& InTraceHandle,
+	FOverlapDatum& InOverlapDatum, TArray<FVigilBroadphaseRequest> Members)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilBroadphaseBatcher::HandleGroupOverlapComplete);
+
+	for (const FVigilBroadphaseRequest& Member : Members)
+	{
+		const UVigilTargetSelection* Selection = Member.Selection.Get();
+		if (Selection && IsRequestValid(Member))
+		{
+			Selection->HandleSharedOverlapComplete(Member.TargetingHandle, InOverlapDatum.OutOverlaps);
+		}
+	}
+}
+
+bool UVigilBroadphaseBatcher::IsRequestValid(const FVigilBroadphaseRequest& Request)
+{
+	// Data stores are cleared when the request is released
+	return Request.TargetingHandle.IsValid() && FTargetingSourceContext::Find(Request.TargetingHandle) != nullptr;
+}
+
+TStatId UVigilBroadphaseBatcher::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVigilBroadphaseBatcher, STATGROUP_Tickables);
+}
@@ -0,0 +1,227 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "System/VigilLOSCache.h"
+
+#include "GameFramework/Actor.h"
+#include "Components/SceneComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilLOSCache)
+
+namespace FVigilCVars
+{
+	static bool bVigilLOSCacheEnabled = true;
+	FAutoConsoleVariableRef CVarVigilLOSCacheEnabled(
+		TEXT("p.Vigil.LOSCache.Enable"),
+		bVigilLOSCacheEnabled,
+		TEXT("If true, LOS filters with bUseLOSCache share cached line of sight verdicts"),
+		ECVF_Default);
+
+	static float VigilLOSCacheCellSize = 50.f;
+	FAutoConsoleVariableRef CVarVigilLOSCacheCellSize(
+		TEXT("p.Vigil.LOSCache.CellSize"),
+		VigilLOSCacheCellSize,
+		TEXT("Source locations are quantized to cells of this size, traces from the same cell share verdicts"),
+		ECVF_Default);
+
+	static float VigilLOSCacheTTL = 0.2f;
+	FAutoConsoleVariableRef CVarVigilLOSCacheTTL(
+		TEXT("p.Vigil.LOSCache.TTL"),
+		VigilLOSCacheTTL,
+		TEXT("Verdicts older than this (seconds) are refreshed when the trace budget allows"),
+		ECVF_Default);
+
+	static float VigilLOSCacheMaxStaleTime = 1.f;
+	FAutoConsoleVariableRef CVarVigilLOSCacheMaxStaleTime(
+		TEXT("p.Vigil.LOSCache.MaxStaleTime"),
+		VigilLOSCacheMaxStaleTime,
+		TEXT("Verdicts older than this (seconds) are always traced again regardless of the trace budget"),
+		ECVF_Default);
+
+	static float VigilLOSCacheMoveThreshold = 25.f;
+	FAutoConsoleVariableRef CVarVigilLOSCacheMoveThreshold(
+		TEXT("p.Vigil.LOSCache.MoveThreshold"),
+		VigilLOSCacheMoveThreshold,
+		TEXT("Verdicts are traced again once the source or target has moved further than this since the trace"),
+		ECVF_Default);
+
+	static int32 VigilLOSCacheTraceBudget = 32;
+	FAutoConsoleVariableRef CVarVigilLOSCacheTraceBudget(
+		TEXT("p.Vigil.LOSCache.TraceBudget"),
+		VigilLOSCacheTraceBudget,
+		TEXT("Maximum number of expired verdicts refreshed per frame, 0 for unlimited"),
+		ECVF_Default);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	static bool bVigilLOSCacheDebug = false;
+	FAutoConsoleVariableRef CVarVigilLOSCacheDebug(
+		TEXT("p.Vigil.LOSCache.Debug"),
+		bVigilLOSCacheDebug,
+		TEXT("If true, print Vigil LOS cache stats to screen"),
+		ECVF_Default);
+#endif
+}
+
+UVigilLOSCache* UVigilLOSCache::Get(const UWorld* World)
+{
+	if (!FVigilCVars::bVigilLOSCacheEnabled || !IsValid(World))
+	{
+		return nullptr;
+	}
+	return World->GetSubsystem<UVigilLOSCache>();
+}
+
+FVigilLOSCacheKey UVigilLOSCache::MakeKey(uint32 QueryHash, const FVector& SourceLocation, const AActor* TargetActor)
+{
+	const double CellSize = FMath::Max(1.f, FVigilCVars::VigilLOSCacheCellSize);
+	const FIntVector SourceCell(
+		FMath::FloorToInt32(SourceLocation.X / CellSize),
+		FMath::FloorToInt32(SourceLocation.Y / CellSize),
+		FMath::FloorToInt32(SourceLocation.Z / CellSize));
+	return FVigilLOSCacheKey(QueryHash, SourceCell, FObjectKey(TargetActor));
+}
+
+bool UVigilLOSCache::FindVerdict(const FVigilLOSCacheKey& Key, const FVector& SourceLocation,
+	const FVector& TargetLocation, bool& bOutFiltered)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilLOSCache::FindVerdict);
+
+	const FVigilLOSCacheEntry* Entry = Entries.Find(Key);
+	const float MoveThresholdSq = FMath::Square(FVigilCVars::VigilLOSCacheMoveThreshold);
+	if (!Entry || FVector::DistSquared(Entry->SourceLocation, SourceLocation) > MoveThresholdSq ||
+		FVector::DistSquared(Entry->TargetLocation, TargetLocation) > MoveThresholdSq)
+	{
+		// Nothing usable, we must trace
+		NumTracesThisFrame++;
+		return false;
+	}
+
+	const double Age = GetWorld()->GetTimeSeconds() - Entry->Time;
+	if (Age <= FVigilCVars::VigilLOSCacheTTL)
+	{
+		NumHitsThisFrame++;
+		bOutFiltered = Entry->bFiltered;
+		return true;
+	}
+
+	// Expired, refresh if we have budget, otherwise keep using it until a later frame does
+	const int32 Budget = FVigilCVars::VigilLOSCacheTraceBudget;
+	if (Age <= FVigilCVars::VigilLOSCacheMaxStaleTime && Budget > 0 && NumTracesThisFrame >= Budget)
+	{
+		NumStaleHitsThisFrame++;
+		bOutFiltered = Entry->bFiltered;
+		return true;
+	}
+
+	NumTracesThisFrame++;
+	return false;
+}
+
+void UVigilLOSCache::AddVerdict(const FVigilLOSCacheKey& Key, const FVector& SourceLocation,
+	const FVector& TargetLocation, bool bFiltered)
+{
+	FVigilLOSCacheEntry& Entry = Entries.FindOrAdd(Key);
+	Entry.SourceLocation = SourceLocation;
+	Entry.TargetLocation = TargetLocation;
+	Entry.Time = GetWorld()->GetTimeSeconds();
+	Entry.bFiltered = bFiltered;
+}
+
+bool UVigilLOSCache::IsOccluded(FName OccluderTag, const FVector& SourceLocation, const FVector& TargetLocation)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilLOSCache::IsOccluded);
+
+	const FVector Delta = TargetLocation - SourceLocation;
+	if (Delta.IsNearlyZero())
+	{
+		return false;
+	}
+
+	const FVector OneOverDirection = Delta.Reciprocal();
+	for (const FBox& Box : GetOccluders(OccluderTag))
+	{
+		if (!Box.IsInside(SourceLocation) && !Box.IsInside(TargetLocation) &&
+			FMath::LineBoxIntersection(Box, SourceLocation, TargetLocation, Delta, OneOverDirection))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+const TArray<FBox>& UVigilLOSCache::GetOccluders(FName OccluderTag)
+{
+	if (const TArray<FBox>* Boxes = Occluders.Find(OccluderTag))
+	{
+		return *Boxes;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilLOSCache::GatherOccluders);
+
+	TArray<FBox>& Boxes = Occluders.Add(OccluderTag);
+	for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+	{
+		const AActor* Actor = *It;
+		if (Actor->ActorHasTag(OccluderTag) && Actor->GetRootComponent() &&
+			Actor->GetRootComponent()->Mobility == EComponentMobility::Static)
+		{
+			const FBox Box = Actor->GetComponentsBoundingBox(false, false);
+			if (Box.IsValid)
+			{
+				Boxes.Add(Box);
+			}
+		}
+	}
+	return Boxes;
+}
+
+bool UVigilLOSCache::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UVigilLOSCache::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilLOSCache::Tick);
+
+	NumHitsLastFrame = NumHitsThisFrame;
+	NumStaleHitsLastFrame = NumStaleHitsThisFrame;
+	NumTracesLastFrame = NumTracesThisFrame;
+	NumHitsThisFrame = 0;
+	NumStaleHitsThisFrame = 0;
+	NumTracesThisFrame = 0;
+
+	// Remove verdicts that can never be used again
+	const double Now = GetWorld()->GetTimeSeconds();
+	const double MaxStaleTime = FMath::Max(FVigilCVars::VigilLOSCacheTTL, FVigilCVars::VigilLOSCacheMaxStaleTime);
+	if (Now - LastPruneTime >= MaxStaleTime)
+	{
+		LastPruneTime = Now;
+		for (auto It = Entries.CreateIterator(); It; ++It)
+		{
+			if (Now - It.Value().Time > MaxStaleTime)
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilLOSCacheDebug && GEngine)
+	{
+		const int32 UniqueKey = (GetUniqueID() + 317) % INT32_MAX;
+		const FString Info = FString::Printf(TEXT("Vigil LOS Cache: Entries: %d Hits: %d Stale Hits: %d Traces: %d"),
+			Entries.Num(), NumHitsLastFrame, NumStaleHitsLastFrame, NumTracesLastFrame);
+		GEngine->AddOnScreenDebugMessage(UniqueKey, 1.f, FColor::Green, Info);
+	}
+#endif
+}
+
+TStatId UVigilLOSCache::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVigilLOSCache, STATGROUP_Tickables);
+}
@@ -0,0 +1,774 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "System/VigilScanDriver.h"
+
+#include "VigilComponent.h"
+#include "System/VigilScanScheduler.h"
+#include "Targeting/VigilTargetSelection.h"
+#include "GameFramework/Controller.h"
+#include "TargetingSystem/TargetingSubsystem.h"
+#include "TargetingSystem/TargetingPreset.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/GameInstance.h"
+#include "TimerManager.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilScanDriver)
+
+namespace FVigilCVars
+{
+#if UE_ENABLE_DEBUG_DRAWING
+	static int32 VigilScanDebug = 0;
+	FAutoConsoleVariableRef CVarVigilScanDebug(
+		TEXT("p.Vigil.Scan.Debug"),
+		VigilScanDebug,
+		TEXT("Optionally draw debug for Vigil Scan Task.\n")
+		TEXT("0: Disable, 1: Enable for all, 2: Enable for local player only"),
+		ECVF_Default);
+#endif
+}
+
+UWorld* UVigilScanDriver::GetWorld() const
+{
+	if (HasAnyFlags(RF_ClassDefaultObject))
+	{
+		return nullptr;
+	}
+	return VC.IsValid() ? VC->GetWorld() : nullptr;
+}
+
+void UVigilScanDriver::StartScanning(UVigilComponent* InVigilComponent, const FVigilScanDriverSettings& InSettings)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::StartScanning);
+
+	if (bScanning)
+	{
+		StopScanning();
+	}
+
+	VC = InVigilComponent;
+	Settings = InSettings;
+
+	if (!VC.IsValid())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::StartScanning: Invalid VigilComponent. [SYSTEM END]"), *GetRoleString());
+		return;
+	}
+
+	UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::StartScanning: %s"), *GetRoleString(), *VC->GetName());
+
+	bScanning = true;
+
+	// Bind to the pause delegate
+	if (!VC->OnPauseVigil.IsBoundToObject(this))
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::StartScanning: Binding to OnPauseVigil"), *GetRoleString());
+		VC->OnPauseVigil.BindUObject(this, &ThisClass::OnPauseVigil);
+	}
+
+	// Bind to request delegate
+	if (!VC->OnRequestVigil.IsBoundToObject(this))
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::StartScanning: Binding to OnRequestVigil"), *GetRoleString());
+		VC->OnRequestVigil.BindUObject(this, &ThisClass::OnRequestVigil);
+	}
+
+	RequestVigil();
+}
+
+void UVigilScanDriver::StopScanning()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::StopScanning);
+
+	UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::StopScanning"), *GetRoleString());
+
+	bScanning = false;
+	PendingNetSync = EVigilNetSyncPendingState::None;
+
+	if (IsValid(GetWorld()))
+	{
+		GetWorld()->GetTimerManager().ClearAllTimersForObject(this);
+		CancelVigilWaits();
+	}
+
+	if (VC.IsValid())
+	{
+		if (VC->OnPauseVigil.IsBoundToObject(this))
+		{
+			VC->OnPauseVigil.Unbind();
+		}
+		if (VC->OnRequestVigil.IsBoundToObject(this))
+		{
+			VC->OnRequestVigil.Unbind();
+		}
+	}
+}
+
+void UVigilScanDriver::RequestVigilSync()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::RequestVigilSync);
+
+	// Delay the callback until we get next targets
+	PendingNetSync = EVigilNetSyncPendingState::Pending;
+
+	// Request the next Vigil
+	RequestVigil();
+}
+
+void UVigilScanDriver::WaitForVigil(float InDelay, const TOptional<FString>& Reason, const TOptional<FString>& VeryVerboseReason)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::WaitForVigil);
+
+	WaitReason = Reason;
+	VeryVerboseWaitReason = VeryVerboseReason;
+
+	WaitForVigilPipeline(FGameplayTag::EmptyTag, InDelay);
+}
+
+void UVigilScanDriver::WaitForVigilPipeline(const FGameplayTag& PipelineTag, float InDelay)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::WaitForVigilPipeline);
+
+	// Completions of requests started before we stopped would otherwise resume scanning
+	if (!bScanning)
+	{
+		return;
+	}
+	
+	if (!IsValid(GetWorld()))
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::WaitForVigil: Invalid world. [SYSTEM END]"), *GetRoleString());
+		return;
+	}
+
+	// Let the scheduler issue the request so we don't spike alongside every other VigilComponent
+	if (UVigilScanScheduler* Scheduler = GetScheduler())
+	{
+		Scheduler->ScheduleScan(VC.Get(), PipelineTag, InDelay, FOnRequestVigil::CreateUObject(this, &ThisClass::RequestVigil),
+			VC->GetVigilPipelinePriority(PipelineTag));
+		return;
+	}
+
+	// Timers don't accept a zero delay
+	if (InDelay <= 0.f)
+	{
+		// Synchronous requests complete while we're still issuing requests, wait until next frame instead of re-entering
+		if (bIssuingRequests)
+		{
+			InDelay = UE_KINDA_SMALL_NUMBER;
+		}
+		else
+		{
+			RequestVigil();
+			return;
+		}
+	}
+
+	// The timer is still executing during its callback, so IsPipelineWaiting() would skip the very pipeline it is
+	// waking up, invalidate our handle before requesting
+	const FTimerDelegate OnWaitComplete = FTimerDelegate::CreateWeakLambda(this, [this, PipelineTag]
+	{
+		if (FTimerHandle* Timer = PipelineTag.IsValid() ? PipelineTimers.Find(PipelineTag) : &VigilWaitTimer)
+		{
+			Timer->Invalidate();
+		}
+		RequestVigil();
+	});
+
+	FTimerHandle& Timer = PipelineTag.IsValid() ? PipelineTimers.FindOrAdd(PipelineTag) : VigilWaitTimer;
+	GetWorld()->GetTimerManager().SetTimer(Timer, OnWaitComplete, InDelay, false);
+}
+
+bool UVigilScanDriver::IsPipelineWaiting(const FGameplayTag& PipelineTag) const
+{
+	if (!IsValid(GetWorld()))
+	{
+		return false;
+	}
+
+	if (const UVigilScanScheduler* Scheduler = GetScheduler())
+	{
+		if (Scheduler->IsScanScheduled(VC.Get(), PipelineTag))
+		{
+			return true;
+		}
+	}
+
+	const FTimerHandle* Timer = PipelineTag.IsValid() ? PipelineTimers.Find(PipelineTag) : &VigilWaitTimer;
+	return Timer && GetWorld()->GetTimerManager().IsTimerActive(*Timer);
+}
+
+void UVigilScanDriver::CancelVigilPipelineWait(const FGameplayTag& PipelineTag)
+{
+	if (IsValid(GetWorld()))
+	{
+		if (FTimerHandle* Timer = PipelineTag.IsValid() ? PipelineTimers.Find(PipelineTag) : &VigilWaitTimer)
+		{
+			GetWorld()->GetTimerManager().ClearTimer(*Timer);
+		}
+	}
+
+	if (UVigilScanScheduler* Scheduler = GetScheduler())
+	{
+		Scheduler->CancelScan(VC.Get(), PipelineTag);
+	}
+}
+
+void UVigilScanDriver::CancelVigilWaits()
+{
+	if (IsValid(GetWorld()))
+	{
+		GetWorld()->GetTimerManager().ClearTimer(VigilWaitTimer);
+		for (auto& Timer : PipelineTimers)
+		{
+			GetWorld()->GetTimerManager().ClearTimer(Timer.Value);
+		}
+	}
+	PipelineTimers.Reset();
+
+	if (UVigilScanScheduler* Scheduler = GetScheduler())
+	{
+		Scheduler->CancelAllScans(VC.Get());
+	}
+}
+
+void UVigilScanDriver::RequestVigil()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::RequestVigil);
+
+	// Print the last reason we waited, if set
+	if (WaitReason.IsSet())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::WaitForVigil: LastWaitReason: %s [SYSTEM RESUME]"),
+			*GetRoleString(), *WaitReason.GetValue());
+		WaitReason.Reset();
+	}
+	if (VeryVerboseWaitReason.IsSet())
+	{
+		UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::WaitForVigil: LastWaitReason: %s [SYSTEM RESUME]"),
+			*GetRoleString(), *VeryVerboseWaitReason.GetValue());
+		VeryVerboseWaitReason.Reset();
+	}
+	
+	if (!bScanning)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Not scanning. [SYSTEM END]"), *GetRoleString());
+		return;
+	}
+
+	if (!VC.IsValid())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Invalid VigilComponent. [SYSTEM END]"), *GetRoleString());
+		return;
+	}
+
+	// Check if the world and game instance are valid
+	if (!GetWorld() || !GetWorld()->GetGameInstance())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Invalid world or game instance. [SYSTEM WAIT]"), *GetRoleString());
+		WaitForVigil(Settings.ErrorWaitDelay);
+		return;
+	}
+
+	// Get the TargetingSubsystem
+	UTargetingSubsystem* TargetSubsystem = GetWorld()->GetGameInstance()->GetSubsystem<UTargetingSubsystem>();
+	if (!TargetSubsystem)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Invalid TargetingSubsystem. [SYSTEM WAIT]"), *GetRoleString());
+		WaitForVigil(Settings.ErrorWaitDelay, {"Invalid TargetingSubsystem"});
+		return;
+	}
+
+	AActor* TargetingSource = VC->GetTargetingSource();
+	if (!TargetingSource)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Invalid TargetingSource. [SYSTEM WAIT]"), *GetRoleString());
+		WaitForVigil(Settings.ErrorWaitDelay, {"Invalid TargetingSource"});
+		return;
+	}
+	
+	// Scale our scan rate by significance, this may also swap our targeting presets
+	VC->UpdateVigilSignificance();
+
+	// Check for changes to the targeting preset update mode
+	if (VC->bUpdateTargetingPresetsOnPawnChange != VC->bLastUpdateTargetingPresetsOnPawnChange)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: TargetingPresetUpdateMode changed."), *GetRoleString());
+		// Remove or bind the pawn changed binding
+		VC->UpdatePawnChangedBinding();
+		VC->bLastUpdateTargetingPresetsOnPawnChange = VC->bUpdateTargetingPresetsOnPawnChange;
+	}
+
+	// Optionally update the targeting presets
+	if (VC->bUpdateTargetingPresetsOnUpdate)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Updating targeting presets."), *GetRoleString());
+		VC->UpdateTargetingPresets();
+	}
+
+	// Get cached targeting presets
+	const TMap<FGameplayTag, TObjectPtr<UTargetingPreset>>& TargetingPresets = VC->CurrentTargetingPresets;
+	UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: TargetingPresets.Num(): %d"), *GetRoleString(), TargetingPresets.Num());
+
+	if (TargetingPresets.Num() == 0)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: No targeting presets. [SYSTEM WAIT]"), *GetRoleString());
+		WaitForVigil(Settings.ErrorWaitDelay, {}, {"No TargetingPresets"});
+		return;
+	}
+
+	// If we just net synced every pipeline is requested immediately so the prediction window remains valid
+	const bool bNetSyncPending = PendingNetSync == EVigilNetSyncPendingState::Pending;
+
+	// Each pipeline is requested independently, gather the pipelines that are ready to scan
+	TArray<FGameplayTag, TInlineAllocator<4>> ReadyPipelines;
+	TArray<FGameplayTag, TInlineAllocator<4>> CheckedPipelines;
+	for (const auto& Entry : TargetingPresets)
+	{
+		const FGameplayTag PipelineTag = VC->GetPipelineTag(Entry.Key);
+		if (CheckedPipelines.Contains(PipelineTag))
+		{
+			continue;
+		}
+		CheckedPipelines.Add(PipelineTag);
+
+		// Don't re-enter a pipeline that is still running, it will request again when it completes
+		if (IsPipelineSaturated(PipelineTag))
+		{
+			continue;
+		}
+
+		// The pipeline will request again when its wait completes
+		if (IsPipelineWaiting(PipelineTag))
+		{
+			if (!bNetSyncPending)
+			{
+				continue;
+			}
+			CancelVigilPipelineWait(PipelineTag);
+		}
+
+		// Are we on cooldown due to rate throttling?
+		const float MaxRate = bNetSyncPending ? 0.f : VC->GetMaxVigilPipelineScanRate(PipelineTag);
+		UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: Pipeline: %s MaxRate: %.2f"), *GetRoleString(), *PipelineTag.ToString(), MaxRate);
+		if (MaxRate > 0.f)
+		{
+			// (Thinking out loud...)
+			// If updated at 10.0, rate is 0.1, current time is 10.05
+			// TimeSince is 0.05, TimeSince < MaxRate == 0.05 < 0.1 == true
+			// TimeLeft = MaxRate - TimeSince == 0.1 - 0.05 == 0.05
+
+			const float* LastScanTime = VC->LastPipelineScanTimes.Find(PipelineTag);
+			const float TimeSince = GetWorld()->TimeSince(LastScanTime ? *LastScanTime : -1.f);
+			UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: TimeSince: %.2f"), *GetRoleString(), TimeSince);
+			if (LastScanTime && TimeSince < MaxRate)
+			{
+				const float TimeLeft = MaxRate - TimeSince;
+				UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: TimeLeft: %.2f [PIPELINE WAIT]"), *GetRoleString(), TimeLeft);
+				WaitForVigilPipeline(PipelineTag, TimeLeft);
+				continue;
+			}
+		}
+
+		VC->LastPipelineScanTimes.Add(PipelineTag, GetWorld()->GetTimeSeconds());
+		VC->LastVigilScanTime = GetWorld()->GetTimeSeconds();
+		ReadyPipelines.Add(PipelineTag);
+	}
+
+	TGuardValue<bool> IssuingRequestsGuard(bIssuingRequests, true);
+	for (const FGameplayTag& PipelineTag : ReadyPipelines)
+	{
+		bool bAwaitingCallback = false;
+		bool bSkippedStationary = false;
+		for (const auto& Entry : TargetingPresets)
+		{
+			const FGameplayTag& Tag = Entry.Key;
+			const UTargetingPreset* Preset = Entry.Value;
+
+			if (VC->GetPipelineTag(Tag) != PipelineTag)
+			{
+				continue;
+			}
+
+			if (!Preset || !Preset->GetTargetingTaskSet() || Preset->GetTargetingTaskSet()->Tasks.IsEmpty())
+			{
+				// If the only available presets only have empty tasks Vigil will never get a callback
+				continue;
+			}
+			
+			FTargetingRequestHandle Handle = TargetSubsystem->MakeTargetRequestHandle(Preset, FTargetingSourceContext {TargetingSource});
+
+			// Skip the scan if the source hasn't moved, our current focus results are still valid
+			if (!bNetSyncPending && ShouldSkipStationaryScan(Handle, Tag, Preset))
+			{
+				UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: Skipping TargetingPresets[%s], source is stationary"), *GetRoleString(), *Tag.ToString());
+				UTargetingSubsystem::ReleaseTargetRequestHandle(Handle);
+				bSkippedStationary = true;
+				continue;
+			}
+
+			// When pipelined, the earlier request is still in progress and this one waits behind it
+			if (VC->TargetingRequests.Contains(Tag))
+			{
+				VC->PipelinedTargetingRequests.Add(Tag, Handle);
+			}
+			else
+			{
+				VC->TargetingRequests.Add(Tag, Handle);
+			}
+			RequestStartTimes.Add(Handle, GetWorld()->GetTimeSeconds());
+			const uint32 Sequence = ++IssuedSequences.FindOrAdd(Tag);
+
+#if WITH_EDITOR
+			// Debug the frame where the call was made vs completed
+			const uint64 DebugFrame = GFrameCounter;
+#endif
+			
+			bAwaitingCallback = true;
+
+			// If we just net synced then perform the request sync (immediate) so the prediction window remains valid
+			if (bNetSyncPending)
+			{
+				TargetSubsystem->ExecuteTargetingRequestWithHandle(Handle,
+					FTargetingRequestDelegate::CreateUObject(this, &ThisClass::OnVigilCompleteSync, Tag, Sequence));
+			}
+			else
+			{
+				FTargetingAsyncTaskData& AsyncTaskData = FTargetingAsyncTaskData::FindOrAdd(Handle);
+				AsyncTaskData.bReleaseOnCompletion = true;
+
+				TargetSubsystem->StartAsyncTargetingRequestWithHandle(Handle,
+					FTargetingRequestDelegate::CreateUObject(this, &ThisClass::OnVigilComplete, Tag, Sequence));
+			}
+			
+			UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::RequestVigil: Start async targeting for TargetingPresets[%s]: %s"), *GetRoleString(), *Tag.ToString(), *GetNameSafe(Preset));
+		}
+
+		if (bAwaitingCallback && Settings.bPipelined && !bNetSyncPending)
+		{
+			// Issue the next request once throttling allows, without waiting for this one to complete
+			WaitForVigilPipeline(PipelineTag, 0.f);
+		}
+		else if (!bAwaitingCallback && bSkippedStationary)
+		{
+			// Check again once the pipeline is no longer throttled
+			WaitForVigilPipeline(PipelineTag, 0.f);
+		}
+		else if (!bAwaitingCallback)
+		{
+			// Failed to start any async targeting requests for this pipeline
+			UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::RequestVigil: Failed to start async targeting requests for pipeline %s - TargetingTaskSet(s) are empty or no Preset assigned! Bad setup! [PIPELINE WAIT]"),
+				*GetRoleString(), *PipelineTag.ToString());
+			WaitForVigilPipeline(PipelineTag, Settings.ErrorWaitDelay);
+		}
+	}
+
+	// Guard against requests that never complete
+	if (ReadyPipelines.Num() > 0 && !GetWorld()->GetTimerManager().IsTimerActive(FailsafeTimer))
+	{
+		SetFailsafeTimer();
+	}
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (IsInGameThread() && GEngine)
+	{
+		if (FVigilCVars::VigilScanDebug > 0)
+		{
+			const AController* Controller = Cast<AController>(VC->GetOwner());
+			const bool bIsLocalPlayer = Controller && Controller->IsLocalPlayerController();
+			if (FVigilCVars::VigilScanDebug == 1 || bIsLocalPlayer)
+			{
+				// Draw the number of current requests to screen		
+				const int32 UniqueKey = (VC->GetUniqueID() + 297) % INT32_MAX;
+				const FString Info = FString::Printf(TEXT("Vigil TargetingRequests: %d"), VC->TargetingRequests.Num());
+				GEngine->AddOnScreenDebugMessage(UniqueKey, 5.f, FColor::Green, Info);
+			}
+		}
+	}	
+#endif
+}
+
+bool UVigilScanDriver::ShouldSkipStationaryScan(const FTargetingRequestHandle& TargetingHandle, const FGameplayTag& FocusTag,
+	const UTargetingPreset* Preset) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::ShouldSkipStationaryScan);
+
+	if (!VC->bSkipScansWhenSourceStationary || !Preset || !Preset->GetTargetingTaskSet())
+	{
+		return false;
+	}
+
+	// The selection task determines the pose we scan from, without one we can't tell if anything changed
+	for (const UTargetingTask* Task : Preset->GetTargetingTaskSet()->Tasks)
+	{
+		if (const UVigilTargetSelection* Selection = Cast<UVigilTargetSelection>(Task))
+		{
+			FVector SourceLocation;
+			FQuat SourceRotation;
+			Selection->GetSourcePose(TargetingHandle, SourceLocation, SourceRotation);
+			return VC->ShouldSkipStationaryScan(FocusTag, SourceLocation, SourceRotation);
+		}
+	}
+	return false;
+}
+
+bool UVigilScanDriver::IsPipelineSaturated(const FGameplayTag& PipelineTag) const
+{
+	if (!Settings.bPipelined)
+	{
+		return VC->IsPipelineInFlight(PipelineTag);
+	}
+
+	// Pipelined requests are saturated once any preset in the pipeline has a second request in progress
+	for (const auto& Request : VC->PipelinedTargetingRequests)
+	{
+		if (VC->GetPipelineTag(Request.Key) == PipelineTag)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void UVigilScanDriver::OnVigilCompleteSync(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag, uint32 Sequence)
+{
+	PendingNetSync = EVigilNetSyncPendingState::Completed;
+	OnVigilComplete(TargetingHandle, FocusTag, Sequence);
+	VC->OnNetSyncCallback();
+}
+
+void UVigilScanDriver::OnVigilComplete(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag, uint32 Sequence)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::OnVigilComplete);
+
+#if WITH_EDITOR
+	// Debug the frame where the call was made vs completed
+	const uint64 DebugFrame = GFrameCounter;
+#endif
+	
+	UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::OnVigilComplete: %s"), *GetRoleString(), *FocusTag.ToString());
+
+	if (!VC.IsValid())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::OnVigilComplete: Invalid VigilComponent. [SYSTEM WAIT]"), *GetRoleString());
+		WaitForVigil(Settings.ErrorWaitDelay, {"Invalid VigilComponent"});
+		return;
+	}
+	
+	// Check if the world and game instance are valid
+	if (!GetWorld() || !GetWorld()->GetGameInstance())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::OnVigilComplete: Invalid world or game instance. [SYSTEM WAIT]"), *GetRoleString());
+		VC->EndAllTargetingRequests();
+		WaitForVigil(Settings.ErrorWaitDelay, {}, {"Invalid world or game instance"});
+		return;
+	}
+
+	// Get the TargetingSubsystem
+	const UTargetingSubsystem* TargetSubsystem = GetWorld()->GetGameInstance()->GetSubsystem<UTargetingSubsystem>();
+	if (!TargetSubsystem)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::OnVigilComplete: Invalid TargetingSubsystem. [SYSTEM WAIT]"), *GetRoleString());
+		VC->EndAllTargetingRequests();
+		WaitForVigil(Settings.ErrorWaitDelay, {}, {"Invalid TargetingSubsystem"});
+		return;
+	}
+
+	// A newer request for this preset already completed, these results are out of date
+	uint32& CompletedSequence = CompletedSequences.FindOrAdd(FocusTag);
+	const bool bStale = Sequence <= CompletedSequence;
+	CompletedSequence = FMath::Max(CompletedSequence, Sequence);
+
+	// Get the results from the TargetingSubsystem
+	TArray<FVigilFocusResult> FocusResults;
+	if (TargetingHandle.IsValid())
+	{
+		// Process results
+		const FTargetingDefaultResultsSet* Results = bStale ? nullptr : FTargetingDefaultResultsSet::Find(TargetingHandle);
+		if (Results)
+		{
+			// Metrics computed during the request, so listeners and debug drawing don't recompute them
+			FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+			if (RequestData && RequestData->bValid)
+			{
+				RequestData->SyncCandidateMetrics(Results->TargetResults);
+			}
+			else
+			{
+				RequestData = nullptr;
+			}
+
+			// Results are sorted, so the best are first
+			const int32 MaxResults = VC->GetMaxFocusResults(FocusTag);
+			const int32 NumResults = MaxResults > 0 ? FMath::Min(MaxResults, Results->TargetResults.Num()) : Results->TargetResults.Num();
+
+			FocusResults.Reserve(NumResults);
+			for (int32 i = 0; i < NumResults; i++)
+			{
+				const FTargetingDefaultResultData& ResultData = Results->TargetResults[i];
+				FVigilFocusResult Result = { FocusTag, ResultData.HitResult, ResultData.Score };
+				if (RequestData)
+				{
+					RequestData->EnsureAngle(RequestData->CandidateMetrics[i]);
+					Result.Metrics = RequestData->CandidateMetrics[i];
+				}
+				FocusResults.Add(Result);
+			}
+		}
+
+		// Remove the request handle, only if it is ours -- when pipelined the next request may already be in progress
+		const FTargetingRequestHandle* Handle = VC->TargetingRequests.Find(FocusTag);
+		if (Handle && *Handle == TargetingHandle)
+		{
+			// Promote the pipelined request
+			FTargetingRequestHandle PipelinedHandle;
+			if (VC->PipelinedTargetingRequests.RemoveAndCopyValue(FocusTag, PipelinedHandle))
+			{
+				VC->TargetingRequests.Add(FocusTag, PipelinedHandle);
+			}
+			else
+			{
+				VC->TargetingRequests.Remove(FocusTag);
+			}
+		}
+		else
+		{
+			const FTargetingRequestHandle* PipelinedHandle = VC->PipelinedTargetingRequests.Find(FocusTag);
+			if (PipelinedHandle && *PipelinedHandle == TargetingHandle)
+			{
+				VC->PipelinedTargetingRequests.Remove(FocusTag);
+			}
+		}
+		RequestStartTimes.Remove(TargetingHandle);
+	}
+
+	// Request the next scan before broadcasting so it is already in progress while listeners process the results
+	// Don't request the next scan if the pipeline is saturated -- otherwise we will re-enter RequestVigil multiple times
+	// Other pipelines keep running at their own rate
+	const FGameplayTag PipelineTag = VC->GetPipelineTag(FocusTag);
+	if (Settings.bPipelined && !IsPipelineSaturated(PipelineTag))
+	{
+		WaitForVigilPipeline(PipelineTag, 0.f);
+	}
+
+	if (bStale)
+	{
+		UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::OnVigilComplete: Discarding stale results for %s, sequence %u."),
+			*GetRoleString(), *FocusTag.ToString(), Sequence);
+	}
+	else
+	{
+		// Broadcast the results
+		UE_LOG(LogVigil, VeryVerbose, TEXT("%s VigilScanDriver::OnVigilComplete: Broadcasting %d results."), *GetRoleString(), FocusResults.Num());
+		VC->VigilTargetsReady(FocusTag, FocusResults);
+	}
+
+	if (!Settings.bPipelined && VC.IsValid() && !VC->IsPipelineInFlight(PipelineTag))
+	{
+		// Request the pipeline's next scan, via the scheduler if available
+		WaitForVigilPipeline(PipelineTag, 0.f);
+	}
+
+	SetFailsafeTimer();
+}
+
+void UVigilScanDriver::SetFailsafeTimer()
+{
+	if (!IsValid(GetWorld()))
+	{
+		return;
+	}
+
+	// Fail-safe timer to ensure we don't hang indefinitely -- this occurs due to an engine bug where the TargetingSubsystem
+	// loses all of its requests when another player joins (so far confirmed for running under one process in PIE only)
+	auto OnFailsafeTimer = [this]
+	{
+		if (!VC.IsValid() || VC->TargetingRequests.Num() == 0 || !IsValid(GetWorld()))
+		{
+			return;
+		}
+
+		// Pipelines run independently so there is usually a request in flight, only end those that have hung
+		TArray<FGameplayTag, TInlineAllocator<4>> HungRequests;
+		for (const auto& Request : VC->TargetingRequests)
+		{
+			const float* StartTime = RequestStartTimes.Find(Request.Value);
+			if (!StartTime || GetWorld()->TimeSince(*StartTime) >= Settings.FailsafeDelay)
+			{
+				HungRequests.Add(Request.Key);
+			}
+		}
+
+		if (HungRequests.Num() > 0)
+		{
+			UE_LOG(LogVigil, Error, TEXT("%s VigilScanDriver hung with %d targeting requests. Retrying..."), *GetRoleString(), HungRequests.Num());
+			for (const FGameplayTag& FocusTag : HungRequests)
+			{
+				if (const FTargetingRequestHandle* Handle = VC->TargetingRequests.Find(FocusTag))
+				{
+					RequestStartTimes.Remove(*Handle);
+				}
+				if (const FTargetingRequestHandle* Handle = VC->PipelinedTargetingRequests.Find(FocusTag))
+				{
+					RequestStartTimes.Remove(*Handle);
+				}
+				VC->EndTargetingRequests(FocusTag, false);
+			}
+			RequestVigil();
+		}
+		else
+		{
+			SetFailsafeTimer();
+		}
+	};
+
+	// Weak Lambda is used because OnDestroy isn't called at the correct point in the engine lifecycle after UEngine::Browse (open map)
+	GetWorld()->GetTimerManager().SetTimer(FailsafeTimer, FTimerDelegate::CreateWeakLambda(this, OnFailsafeTimer),
+		Settings.FailsafeDelay, false);
+}
+
+void UVigilScanDriver::OnPauseVigil(bool bPaused)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::OnPauseVigil);
+	
+	UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::OnPauseVigil: %s"), *GetRoleString(), bPaused ? TEXT("Paused") : TEXT("Unpaused"));
+	if (bPaused)
+	{
+		// Cancel the current Vigil
+		CancelVigilWaits();
+	}
+	else
+	{
+		// Request the next Vigil
+		RequestVigil();
+	}
+}
+
+void UVigilScanDriver::OnRequestVigil()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanDriver::OnRequestVigil);
+
+	UE_LOG(LogVigil, Verbose, TEXT("%s VigilScanDriver::OnRequestVigil"), *GetRoleString());
+
+	// VigilComponent ended all our targeting requests and is notifying us to continue
+	if (IsValid(GetWorld()))
+	{
+		// Only continue if we're not already waiting to continue, pipelines that are waiting are skipped by RequestVigil
+		if (!IsPipelineWaiting(FGameplayTag::EmptyTag))
+		{
+			RequestVigil();
+		}
+	}
+}
+
+UVigilScanScheduler* UVigilScanDriver::GetScheduler() const
+{
+	// Scheduling is per-component, until we have one we use our own timer
+	return VC.IsValid() ? UVigilScanScheduler::Get(GetWorld()) : nullptr;
+}
+
+FString UVigilScanDriver::GetRoleString() const
+{
+	return VC.IsValid() ? VC->GetRoleString() : FString();
+}
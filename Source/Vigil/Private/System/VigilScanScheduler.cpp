@@ -0,0 +1,293 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "System/VigilScanScheduler.h"
+
+#include "VigilComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Algo/StableSort.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilScanScheduler)
+
+namespace FVigilCVars
+{
+	static bool bVigilSchedulerEnabled = true;
+	FAutoConsoleVariableRef CVarVigilSchedulerEnabled(
+		TEXT("p.Vigil.Scheduler.Enable"),
+		bVigilSchedulerEnabled,
+		TEXT("If true, Vigil scans are issued by the world scan scheduler instead of per-task timers.\n")
+		TEXT("Takes effect the next time a scan is scheduled"),
+		ECVF_Default);
+
+	static int32 VigilSchedulerMaxScansPerFrame = 32;
+	FAutoConsoleVariableRef CVarVigilSchedulerMaxScansPerFrame(
+		TEXT("p.Vigil.Scheduler.MaxScansPerFrame"),
+		VigilSchedulerMaxScansPerFrame,
+		TEXT("Maximum number of Vigil scans the scheduler will issue per frame, the rest are deferred round-robin.\n")
+		TEXT("0: Unlimited"),
+		ECVF_Default);
+
+	static float VigilSchedulerBudgetMs = 1.f;
+	FAutoConsoleVariableRef CVarVigilSchedulerBudgetMs(
+		TEXT("p.Vigil.Scheduler.BudgetMs"),
+		VigilSchedulerBudgetMs,
+		TEXT("Time in milliseconds the scheduler may spend issuing Vigil scans per frame, the rest are deferred round-robin.\n")
+		TEXT("0: Unlimited"),
+		ECVF_Default);
+
+	static float VigilSchedulerStaggerWindow = 0.1f;
+	FAutoConsoleVariableRef CVarVigilSchedulerStaggerWindow(
+		TEXT("p.Vigil.Scheduler.StaggerWindow"),
+		VigilSchedulerStaggerWindow,
+		TEXT("Time in seconds over which the first scan of each component is staggered, when the component does not throttle its scan rate"),
+		ECVF_Default);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	static bool bVigilSchedulerDebug = false;
+	FAutoConsoleVariableRef CVarVigilSchedulerDebug(
+		TEXT("p.Vigil.Scheduler.Debug"),
+		bVigilSchedulerDebug,
+		TEXT("If true, print Vigil scan scheduler stats to screen"),
+		ECVF_Default);
+#endif
+}
+
+UVigilScanScheduler* UVigilScanScheduler::Get(const UWorld* World)
+{
+	if (!FVigilCVars::bVigilSchedulerEnabled || !IsValid(World))
+	{
+		return nullptr;
+	}
+	return World->GetSubsystem<UVigilScanScheduler>();
+}
+
+void UVigilScanScheduler::RegisterComponent(UVigilComponent* Component)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanScheduler::RegisterComponent);
+
+	if (IsValid(Component))
+	{
+		Components.Add(FObjectKey(Component), Component);
+	}
+}
+
+void UVigilScanScheduler::UnregisterComponent(UVigilComponent* Component)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanScheduler::UnregisterComponent);
+
+	const FObjectKey ComponentKey(Component);
+	Components.Remove(ComponentKey);
+
+	for (int32 i = Scans.Num() - 1; i >= 0; i--)
+	{
+		if (Scans[i].ComponentKey == ComponentKey)
+		{
+			RemoveScanAt(i);
+		}
+	}
+}
+
+void UVigilScanScheduler::ScheduleScan(UVigilComponent* Component, const FGameplayTag& PipelineTag, float Delay,
+	const FOnRequestVigil& Callback, int32 Priority)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanScheduler::ScheduleScan);
+
+	if (!IsValid(Component))
+	{
+		return;
+	}
+
+	// Components that began play before the scheduler existed register on demand
+	RegisterComponent(Component);
+
+	FVigilScheduledScan* Scan = FindScan(Component, PipelineTag);
+	if (!Scan)
+	{
+		// Golden ratio sequence spreads phases evenly regardless of how many pipelines are scheduled
+		const float Phase = FMath::Frac(NumRegistrations++ * 0.618034f);
+
+		const int32 Index = Scans.Emplace(Component, PipelineTag, Phase);
+		ScanIndices.Add(FScanKey(FObjectKey(Component), PipelineTag), Index);
+		Scan = &Scans[Index];
+	}
+
+	Scan->Callback = Callback;
+	Scan->DueTime = GetWorld()->GetTimeSeconds() + FMath::Max(0.f, Delay);
+	Scan->Priority = Priority;
+	Scan->bScheduled = true;
+
+	// Offset the first scan by this pipeline's phase so scans don't all start on the same frame
+	if (!Scan->bStaggered)
+	{
+		Scan->bStaggered = true;
+		const float MaxRate = Component->GetMaxVigilPipelineScanRate(PipelineTag);
+		const float Window = MaxRate > 0.f ? MaxRate : FVigilCVars::VigilSchedulerStaggerWindow;
+		Scan->DueTime += Scan->Phase * Window;
+	}
+}
+
+void UVigilScanScheduler::CancelScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag)
+{
+	if (FVigilScheduledScan* Scan = FindScan(Component, PipelineTag))
+	{
+		Scan->bScheduled = false;
+		Scan->Callback.Unbind();
+	}
+}
+
+void UVigilScanScheduler::CancelAllScans(const UVigilComponent* Component)
+{
+	const FObjectKey ComponentKey(Component);
+	for (FVigilScheduledScan& Scan : Scans)
+	{
+		if (Scan.ComponentKey == ComponentKey)
+		{
+			Scan.bScheduled = false;
+			Scan.Callback.Unbind();
+		}
+	}
+}
+
+bool UVigilScanScheduler::IsScanScheduled(const UVigilComponent* Component, const FGameplayTag& PipelineTag) const
+{
+	const FVigilScheduledScan* Scan = FindScan(Component, PipelineTag);
+	return Scan && Scan->bScheduled;
+}
+
+bool UVigilScanScheduler::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UVigilScanScheduler::Tick(float DeltaTime)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilScanScheduler::Tick);
+
+	NumIssuedLastFrame = 0;
+	NumDeferredLastFrame = 0;
+
+	// Remove components that were destroyed without unregistering
+	for (int32 i = Scans.Num() - 1; i >= 0; i--)
+	{
+		if (!Scans[i].Component.IsValid())
+		{
+			Components.Remove(Scans[i].ComponentKey);
+			RemoveScanAt(i);
+		}
+	}
+
+	const int32 NumScans = Scans.Num();
+	if (NumScans == 0)
+	{
+		return;
+	}
+
+	const double Now = GetWorld()->GetTimeSeconds();
+	const int32 MaxScansPerFrame = FVigilCVars::VigilSchedulerMaxScansPerFrame;
+	const double BudgetSeconds = FVigilCVars::VigilSchedulerBudgetMs * 0.001;
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Gather due scans, starting where we left off last frame so deferred scans are served first
+	// Keys rather than indices, callbacks can add or remove scans which reorders the array
+	TArray<TPair<FScanKey, int32>, TInlineAllocator<64>> DueScans;
+	for (int32 i = 0; i < NumScans; i++)
+	{
+		const int32 Index = (RoundRobinIndex + i) % NumScans;
+		const FVigilScheduledScan& Scan = Scans[Index];
+		if (Scan.bScheduled && Scan.DueTime <= Now && Scan.Component.IsValid())
+		{
+			DueScans.Emplace(FScanKey(Scan.ComponentKey, Scan.PipelineTag), Scan.Priority);
+		}
+	}
+
+	// Higher priority pipelines go first, stable so round-robin order is kept within a priority
+	Algo::StableSortBy(DueScans, [](const TPair<FScanKey, int32>& DueScan) { return DueScan.Value; }, TGreater<>());
+
+	int32 NextRoundRobinIndex = RoundRobinIndex;
+	bool bOutOfBudget = false;
+	for (const TPair<FScanKey, int32>& DueScan : DueScans)
+	{
+		const int32* Index = ScanIndices.Find(DueScan.Key);
+		if (!Index || !Scans[*Index].bScheduled)
+		{
+			continue;
+		}
+
+		if (bOutOfBudget)
+		{
+			NumDeferredLastFrame++;
+			continue;
+		}
+
+		// Copy the callback, it will likely schedule the next scan
+		FVigilScheduledScan& Scan = Scans[*Index];
+		const FOnRequestVigil Callback = Scan.Callback;
+		Scan.bScheduled = false;
+		Scan.Callback.Unbind();
+		NextRoundRobinIndex = *Index + 1;
+		Callback.ExecuteIfBound();
+
+		NumIssuedLastFrame++;
+
+		const bool bOverScanLimit = MaxScansPerFrame > 0 && NumIssuedLastFrame >= MaxScansPerFrame;
+		const bool bOverTimeLimit = BudgetSeconds > 0.0 && FPlatformTime::Seconds() - StartTime >= BudgetSeconds;
+		bOutOfBudget = bOverScanLimit || bOverTimeLimit;
+	}
+
+	RoundRobinIndex = Scans.Num() > 0 ? NextRoundRobinIndex % Scans.Num() : 0;
+
+	// Report frames where the time budget was exceeded
+	const double ElapsedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	if (BudgetSeconds > 0.0 && ElapsedMs > FVigilCVars::VigilSchedulerBudgetMs)
+	{
+		NumBudgetOverruns++;
+		UE_LOG(LogVigil, Verbose, TEXT("VigilScanScheduler: Budget overrun, spent %.3fms of %.3fms issuing %d scans, deferred %d. Total overruns: %d"),
+			ElapsedMs, FVigilCVars::VigilSchedulerBudgetMs, NumIssuedLastFrame, NumDeferredLastFrame, NumBudgetOverruns);
+	}
+	else if (NumDeferredLastFrame > 0)
+	{
+		UE_LOG(LogVigil, VeryVerbose, TEXT("VigilScanScheduler: Issued %d scans, deferred %d"),
+			NumIssuedLastFrame, NumDeferredLastFrame);
+	}
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilSchedulerDebug && GEngine)
+	{
+		const int32 UniqueKey = (GetUniqueID() + 311) % INT32_MAX;
+		const FString Info = FString::Printf(TEXT("Vigil Scheduler: Components: %d Issued: %d Deferred: %d Overruns: %d (%.3fms)"),
+			Components.Num(), NumIssuedLastFrame, NumDeferredLastFrame, NumBudgetOverruns, ElapsedMs);
+		GEngine->AddOnScreenDebugMessage(UniqueKey, 1.f, FColor::Green, Info);
+	}
+#endif
+}
+
+TStatId UVigilScanScheduler::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVigilScanScheduler, STATGROUP_Tickables);
+}
+
+FVigilScheduledScan* UVigilScanScheduler::FindScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag)
+{
+	const int32* Index = ScanIndices.Find(FScanKey(FObjectKey(Component), PipelineTag));
+	return Index ? &Scans[*Index] : nullptr;
+}
+
+const FVigilScheduledScan* UVigilScanScheduler::FindScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag) const
+{
+	const int32* Index = ScanIndices.Find(FScanKey(FObjectKey(Component), PipelineTag));
+	return Index ? &Scans[*Index] : nullptr;
+}
+
+void UVigilScanScheduler::RemoveScanAt(int32 Index)
+{
+	ScanIndices.Remove(FScanKey(Scans[Index].ComponentKey, Scans[Index].PipelineTag));
+	Scans.RemoveAtSwap(Index);
+
+	// The last scan moved into Index
+	if (Scans.IsValidIndex(Index))
+	{
+		ScanIndices.Add(FScanKey(Scans[Index].ComponentKey, Scans[Index].PipelineTag), Index);
+	}
+}
@@ -0,0 +1,278 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Targeting/VigilCandidateBuffer.h"
+
+#include "Math/VectorRegister.h"
+
+#if !UE_BUILD_SHIPPING
+#include "VigilTypes.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#endif
+
+
+void FVigilCandidateBuffer::Reset(int32 ExpectedNum)
+{
+	const int32 PaddedNum = Align(ExpectedNum, 4);
+	X.Reset(PaddedNum);
+	Y.Reset(PaddedNum);
+	Z.Reset(PaddedNum);
+	SourceIndices.Reset(ExpectedNum);
+	Inside.Reset(PaddedNum);
+}
+
+void FVigilCandidateBuffer::Add(const FVector& RelativeLocation, int32 SourceIndex)
+{
+	X.Add(static_cast<float>(RelativeLocation.X));
+	Y.Add(static_cast<float>(RelativeLocation.Y));
+	Z.Add(static_cast<float>(RelativeLocation.Z));
+	SourceIndices.Add(SourceIndex);
+}
+
+int32 FVigilCandidateBuffer::Pad()
+{
+	// Padded lanes are tested but never read
+	const int32 PaddedNum = Align(Num(), 4);
+	while (X.Num() < PaddedNum)
+	{
+		X.Add(0.f);
+		Y.Add(0.f);
+		Z.Add(0.f);
+	}
+	Inside.SetNumUninitialized(PaddedNum);
+	return PaddedNum;
+}
+
+void FVigilCandidateBuffer::TestCone(const FVector& Direction, const FVector& Right, const FVector& Up, float Length,
+	float TanHalfWidth, float TanHalfHeight)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilCandidateBuffer::TestCone);
+
+	const int32 PaddedNum = Pad();
+
+	const VectorRegister4Float DirX = VectorSetFloat1(static_cast<float>(Direction.X));
+	const VectorRegister4Float DirY = VectorSetFloat1(static_cast<float>(Direction.Y));
+	const VectorRegister4Float DirZ = VectorSetFloat1(static_cast<float>(Direction.Z));
+	const VectorRegister4Float RightX = VectorSetFloat1(static_cast<float>(Right.X));
+	const VectorRegister4Float RightY = VectorSetFloat1(static_cast<float>(Right.Y));
+	const VectorRegister4Float RightZ = VectorSetFloat1(static_cast<float>(Right.Z));
+	const VectorRegister4Float UpX = VectorSetFloat1(static_cast<float>(Up.X));
+	const VectorRegister4Float UpY = VectorSetFloat1(static_cast<float>(Up.Y));
+	const VectorRegister4Float UpZ = VectorSetFloat1(static_cast<float>(Up.Z));
+	const VectorRegister4Float LengthV = VectorSetFloat1(Length);
+	const VectorRegister4Float TanWidthV = VectorSetFloat1(TanHalfWidth);
+	const VectorRegister4Float TanHeightV = VectorSetFloat1(TanHalfHeight);
+	const VectorRegister4Float Zero = VectorZeroFloat();
+
+	for (int32 i = 0; i < PaddedNum; i += 4)
+	{
+		const VectorRegister4Float PX = VectorLoad(&X[i]);
+		const VectorRegister4Float PY = VectorLoad(&Y[i]);
+		const VectorRegister4Float PZ = VectorLoad(&Z[i]);
+
+		// Project onto the cone's axes
+		const VectorRegister4Float Forward = VectorMultiplyAdd(PZ, DirZ, VectorMultiplyAdd(PY, DirY, VectorMultiply(PX, DirX)));
+		const VectorRegister4Float Side = VectorAbs(VectorMultiplyAdd(PZ, RightZ, VectorMultiplyAdd(PY, RightY, VectorMultiply(PX, RightX))));
+		const VectorRegister4Float Height = VectorAbs(VectorMultiplyAdd(PZ, UpZ, VectorMultiplyAdd(PY, UpY, VectorMultiply(PX, UpX))));
+
+		// In front of the rear, within the length, and within the half angles
+		VectorRegister4Float Mask = VectorBitwiseAnd(VectorCompareGE(Forward, Zero), VectorCompareLE(Forward, LengthV));
+		Mask = VectorBitwiseAnd(Mask, VectorCompareLE(Side, VectorMultiply(Forward, TanWidthV)));
+		Mask = VectorBitwiseAnd(Mask, VectorCompareLE(Height, VectorMultiply(Forward, TanHeightV)));
+
+		const int32 Bits = VectorMaskBits(Mask);
+		Inside[i + 0] = (Bits & 1) ? 1 : 0;
+		Inside[i + 1] = (Bits & 2) ? 1 : 0;
+		Inside[i + 2] = (Bits & 4) ? 1 : 0;
+		Inside[i + 3] = (Bits & 8) ? 1 : 0;
+	}
+}
+
+void FVigilCandidateBuffer::TestCylinder(float Radius, float HalfHeight, bool bTestHeight)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilCandidateBuffer::TestCylinder);
+
+	const int32 PaddedNum = Pad();
+
+	const VectorRegister4Float RadiusSqV = VectorSetFloat1(Radius * Radius);
+	const VectorRegister4Float HalfHeightV = VectorSetFloat1(bTestHeight ? HalfHeight : UE_BIG_NUMBER);
+
+	for (int32 i = 0; i < PaddedNum; i += 4)
+	{
+		const VectorRegister4Float PX = VectorLoad(&X[i]);
+		const VectorRegister4Float PY = VectorLoad(&Y[i]);
+		const VectorRegister4Float PZ = VectorLoad(&Z[i]);
+
+		const VectorRegister4Float DistSq2D = VectorMultiplyAdd(PY, PY, VectorMultiply(PX, PX));
+		const VectorRegister4Float Mask = VectorBitwiseAnd(VectorCompareLE(DistSq2D, RadiusSqV),
+			VectorCompareLE(VectorAbs(PZ), HalfHeightV));
+
+		const int32 Bits = VectorMaskBits(Mask);
+		Inside[i + 0] = (Bits & 1) ? 1 : 0;
+		Inside[i + 1] = (Bits & 2) ? 1 : 0;
+		Inside[i + 2] = (Bits & 4) ? 1 : 0;
+		Inside[i + 3] = (Bits & 8) ? 1 : 0;
+	}
+}
+
+#if !UE_BUILD_SHIPPING
+namespace VigilNarrowPhaseBenchmark
+{
+	/** Keep points this far from the shape's boundary, where float and double precision can disagree */
+	static constexpr float BoundaryTolerance = 0.01f;
+
+	static void BenchmarkCone(FRandomStream& Stream, int32 NumPoints, int32 NumIterations, const FVigilConeShape& Cone)
+	{
+		const FVector Direction = Stream.GetUnitVector();
+		FVector Right, Up;
+		Direction.FindBestAxisVectors(Up, Right);
+
+		// Random points around the cone's rear, that aren't on the boundary of its length or angles
+		TArray<FVector> Points;
+		Points.Reserve(NumPoints);
+		while (Points.Num() < NumPoints)
+		{
+			const FVector Point = FVector(Stream.FRandRange(-1.f, 1.f), Stream.FRandRange(-1.f, 1.f), Stream.FRandRange(-1.f, 1.f)) * Cone.Length;
+			const float Forward = Point | Direction;
+			const float AngleWidth = FMath::RadiansToDegrees(FMath::Atan2(FMath::Abs(Point | Right), Forward));
+			const float AngleHeight = FMath::RadiansToDegrees(FMath::Atan2(FMath::Abs(Point | Up), Forward));
+			if (FMath::Abs(Forward) > BoundaryTolerance && FMath::Abs(Forward - Cone.Length) > BoundaryTolerance &&
+				FMath::Abs(AngleWidth - Cone.AngleWidth * 0.5f) > BoundaryTolerance &&
+				FMath::Abs(AngleHeight - Cone.AngleHeight * 0.5f) > BoundaryTolerance)
+			{
+				Points.Add(Point);
+			}
+		}
+
+		const float TanHalfWidth = FVigilConeShape::GetTanHalfAngle(Cone.AngleWidth);
+		const float TanHalfHeight = FVigilConeShape::GetTanHalfAngle(Cone.AngleHeight);
+
+		TArray<uint8> Expected;
+		Expected.SetNumUninitialized(NumPoints);
+		FVigilCandidateBuffer Candidates;
+		double ScalarTime = 0.0;
+		double BatchTime = 0.0;
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+			{
+				Expected[PointIndex] = Cone.IsPointWithinCone(Points[PointIndex], FVector::ZeroVector, Direction) ? 1 : 0;
+			}
+			ScalarTime += FPlatformTime::Seconds() - StartTime;
+
+			// The selection pays for gathering the candidates too
+			StartTime = FPlatformTime::Seconds();
+			Candidates.Reset(NumPoints);
+			for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+			{
+				Candidates.Add(Points[PointIndex], PointIndex);
+			}
+			Candidates.TestCone(Direction, Right, Up, Cone.Length, TanHalfWidth, TanHalfHeight);
+			BatchTime += FPlatformTime::Seconds() - StartTime;
+		}
+
+		int32 NumInside = 0;
+		int32 NumMismatches = 0;
+		for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+		{
+			NumInside += Expected[PointIndex];
+			if (Candidates.Inside[PointIndex] != Expected[PointIndex])
+			{
+				NumMismatches++;
+				UE_LOG(LogVigil, Error, TEXT("Vigil narrow phase benchmark: Cone: %.1f x %.1f Point: %s IsPointWithinCone: %d TestCone: %d"),
+					Cone.AngleWidth, Cone.AngleHeight, *Points[PointIndex].ToString(), Expected[PointIndex], Candidates.Inside[PointIndex]);
+			}
+		}
+
+		const double ScalarUs = ScalarTime * 1e6 / NumIterations;
+		const double BatchUs = BatchTime * 1e6 / NumIterations;
+		UE_LOG(LogVigil, Log, TEXT("Vigil narrow phase benchmark: Cone: %.1f x %.1f Points: %d Inside: %d IsPointWithinCone: %.2fus TestCone: %.2fus Mismatches: %d"),
+			Cone.AngleWidth, Cone.AngleHeight, NumPoints, NumInside, ScalarUs, BatchUs, NumMismatches);
+	}
+
+	static void BenchmarkCylinder(FRandomStream& Stream, int32 NumPoints, int32 NumIterations, float Radius, float HalfHeight)
+	{
+		// Random points around the cylinder, that aren't on the boundary of its radius or height
+		TArray<FVector> Points;
+		Points.Reserve(NumPoints);
+		while (Points.Num() < NumPoints)
+		{
+			const FVector Point(Stream.FRandRange(-2.f, 2.f) * Radius, Stream.FRandRange(-2.f, 2.f) * Radius,
+				Stream.FRandRange(-2.f, 2.f) * HalfHeight);
+			if (FMath::Abs(Point.Size2D() - Radius) > BoundaryTolerance && FMath::Abs(FMath::Abs(Point.Z) - HalfHeight) > BoundaryTolerance)
+			{
+				Points.Add(Point);
+			}
+		}
+
+		TArray<uint8> Expected;
+		Expected.SetNumUninitialized(NumPoints);
+		FVigilCandidateBuffer Candidates;
+		double ScalarTime = 0.0;
+		double BatchTime = 0.0;
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			double StartTime = FPlatformTime::Seconds();
+			for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+			{
+				const FVector& Point = Points[PointIndex];
+				Expected[PointIndex] = FVector::DistSquared2D(Point, FVector::ZeroVector) <= FMath::Square(Radius) &&
+					FMath::Abs(Point.Z) <= HalfHeight ? 1 : 0;
+			}
+			ScalarTime += FPlatformTime::Seconds() - StartTime;
+
+			StartTime = FPlatformTime::Seconds();
+			Candidates.Reset(NumPoints);
+			for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+			{
+				Candidates.Add(Points[PointIndex], PointIndex);
+			}
+			Candidates.TestCylinder(Radius, HalfHeight, true);
+			BatchTime += FPlatformTime::Seconds() - StartTime;
+		}
+
+		int32 NumInside = 0;
+		int32 NumMismatches = 0;
+		for (int32 PointIndex = 0; PointIndex < NumPoints; ++PointIndex)
+		{
+			NumInside += Expected[PointIndex];
+			if (Candidates.Inside[PointIndex] != Expected[PointIndex])
+			{
+				NumMismatches++;
+				UE_LOG(LogVigil, Error, TEXT("Vigil narrow phase benchmark: Cylinder: %.1f x %.1f Point: %s DistSquared2D: %d TestCylinder: %d"),
+					Radius, HalfHeight, *Points[PointIndex].ToString(), Expected[PointIndex], Candidates.Inside[PointIndex]);
+			}
+		}
+
+		const double ScalarUs = ScalarTime * 1e6 / NumIterations;
+		const double BatchUs = BatchTime * 1e6 / NumIterations;
+		UE_LOG(LogVigil, Log, TEXT("Vigil narrow phase benchmark: Cylinder: %.1f x %.1f Points: %d Inside: %d DistSquared2D: %.2fus TestCylinder: %.2fus Mismatches: %d"),
+			Radius, HalfHeight, NumPoints, NumInside, ScalarUs, BatchUs, NumMismatches);
+	}
+
+	static FAutoConsoleCommand CmdNarrowPhaseBenchmark(
+		TEXT("p.Vigil.Selection.NarrowPhaseBenchmark"),
+		TEXT("Log how long the per point cone and cylinder tests take compared to FVigilCandidateBuffer's batched tests, and any points they disagree on.\n")
+		TEXT("Optionally pass the number of iterations, and the number of points per query (at least 1024)"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			const int32 NumIterations = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 100;
+			const int32 NumPoints = Args.Num() > 1 ? FMath::Max(1024, FCString::Atoi(*Args[1])) : 4096;
+
+			FRandomStream Stream(1234);
+
+			// Half angles of 90 degrees and above compare against UE_BIG_NUMBER instead of a tangent
+			for (const FVector2f& Angles : { FVector2f(40.f, 20.f), FVector2f(90.f, 60.f), FVector2f(170.f, 150.f),
+				FVector2f(180.f, 90.f), FVector2f(180.f, 180.f), FVector2f(200.f, 250.f) })
+			{
+				BenchmarkCone(Stream, NumPoints, NumIterations, FVigilConeShape(2000.f, Angles.X, Angles.Y));
+			}
+
+			BenchmarkCylinder(Stream, NumPoints, NumIterations, 1000.f, 200.f);
+			BenchmarkCylinder(Stream, NumPoints, NumIterations, 150.f, 1000.f);
+		}));
+}
+#endif
@@ -10,6 +10,8 @@
 #include "Engine/World.h"
 #include "Components/PrimitiveComponent.h"
 #include "System/VigilVersioning.h"
+#include "System/VigilBroadphaseBatcher.h"
+#include "Targeting/VigilCandidateBuffer.h"
 
 #if UE_ENABLE_DEBUG_DRAWING
 #if WITH_EDITORONLY_DATA
@@ -33,6 +35,58 @@ namespace FVigilCVars
 		TEXT("If true draw debug for Vigil AOE Selection Task"),
 		ECVF_Default);
 #endif
+
+	static int32 VigilSelectionConeBroadphase = -1;
+	FAutoConsoleVariableRef CVarVigilSelectionConeBroadphase(
+		TEXT("p.Vigil.Selection.ConeBroadphase"),
+		VigilSelectionConeBroadphase,
+		TEXT("Override the broadphase used by every Vigil cone selection, to compare them with p.Vigil.Selection.BroadphaseStats.\n")
+		TEXT("-1: Use each selection's ConeBroadphase, 0: Box, 1: BoxChain"),
+		ECVF_Default);
+
+	static float VigilSelectionConeChainMinLength = 2000.f;
+	FAutoConsoleVariableRef CVarVigilSelectionConeChainMinLength(
+		TEXT("p.Vigil.Selection.ConeChainMinLength"),
+		VigilSelectionConeChainMinLength,
+		TEXT("Cones at least this long use a chain of boxes for their broadphase when their ConeBroadphase is Auto"),
+		ECVF_Default);
+}
+
+namespace VigilSelectionStats
+{
+	struct FConeBroadphaseStats
+	{
+		int64 Requests = 0;
+		int64 Candidates = 0;
+		int64 Accepted = 0;
+
+		FString ToString() const
+		{
+			const double CandidatesPerAccepted = Accepted > 0 ? static_cast<double>(Candidates) / Accepted : 0.0;
+			const double CandidatesPerRequest = Requests > 0 ? static_cast<double>(Candidates) / Requests : 0.0;
+			return FString::Printf(TEXT("Requests: %lld Candidates: %lld Accepted: %lld Candidates per accepted: %.2f Candidates per request: %.2f"),
+				Requests, Candidates, Accepted, CandidatesPerAccepted, CandidatesPerRequest);
+		}
+	};
+
+	static FConeBroadphaseStats Box;
+	static FConeBroadphaseStats BoxChain;
+
+	static FAutoConsoleCommand CmdBroadphaseStats(
+		TEXT("p.Vigil.Selection.BroadphaseStats"),
+		TEXT("Log how many broadphase candidates each Vigil cone selection tested for each result it accepted.\n")
+		TEXT("Pass 'reset' to reset the stats"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			if (Args.Num() > 0 && Args[0].Equals(TEXT("reset"), ESearchCase::IgnoreCase))
+			{
+				Box = {};
+				BoxChain = {};
+				return;
+			}
+			UE_LOG(LogVigilTargeting, Log, TEXT("Vigil cone broadphase (Box) %s"), *Box.ToString());
+			UE_LOG(LogVigilTargeting, Log, TEXT("Vigil cone broadphase (BoxChain) %s"), *BoxChain.ToString());
+		}));
 }
 
 UVigilTargetSelection::UVigilTargetSelection(const FObjectInitializer& ObjectInitializer)
@@ -94,12 +148,74 @@ FQuat UVigilTargetSelection::GetSourceRotationOffset_Implementation(
 	return DefaultSourceRotationOffset.Quaternion();
 }
 
+void UVigilTargetSelection::GetSourcePose(const FTargetingRequestHandle& TargetingHandle, FVector& OutLocation,
+	FQuat& OutRotation) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::GetSourcePose);
+	
+	OutLocation = GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
+	OutRotation = (GetSourceRotation(TargetingHandle) * GetSourceRotationOffset(TargetingHandle)).GetNormalized();
+}
+
+const FVigilTargetingRequestData& UVigilTargetSelection::InitRequestData(const FTargetingRequestHandle& TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::InitRequestData);
+
+	FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+	GetSourcePose(TargetingHandle, RequestData.SourceLocation, RequestData.SourceRotation);
+	RequestData.SourceDirection = RequestData.SourceRotation.Vector();
+	RequestData.ShapeType = ShapeType;
+	RequestData.Cone = GetConeShape();
+	RequestData.ConeRear = RequestData.SourceLocation - RequestData.SourceDirection * (RequestData.Cone.Length * 0.5f);
+	RequestData.SourceDirection.FindBestAxisVectors(RequestData.ConeUp, RequestData.ConeRight);
+	RequestData.ConeTanHalfWidth = FVigilConeShape::GetTanHalfAngle(RequestData.Cone.AngleWidth);
+	RequestData.ConeTanHalfHeight = FVigilConeShape::GetTanHalfAngle(RequestData.Cone.AngleHeight);
+	RequestData.HalfExtent = HalfExtent;
+	RequestData.Radius = Radius.GetValue();
+	RequestData.HalfHeight = HalfHeight.GetValue();
+
+	// The max angle and distance are used to normalize scores
+	switch (ShapeType)
+	{
+	case EVigilTargetingShape::Cone:
+		RequestData.MaxAngle = FMath::Max(RequestData.Cone.AngleHeight, RequestData.Cone.AngleWidth);
+		RequestData.MaxDistance = RequestData.Cone.Length;
+		break;
+	case EVigilTargetingShape::Box:
+	case EVigilTargetingShape::Cylinder:
+		RequestData.MaxAngle = FMath::Max3(HalfExtent.X, HalfExtent.Y, HalfExtent.Z);
+		RequestData.MaxDistance = RequestData.MaxAngle;
+		break;
+	case EVigilTargetingShape::Sphere:
+	case EVigilTargetingShape::SourceComponent:
+		RequestData.MaxAngle = RequestData.Radius;
+		RequestData.MaxDistance = RequestData.Radius;
+		break;
+	case EVigilTargetingShape::Capsule:
+		RequestData.MaxAngle = RequestData.HalfHeight;
+		RequestData.MaxDistance = RequestData.HalfHeight;
+		break;
+	}
+
+	RequestData.bValid = true;
+	return RequestData;
+}
+
+const FVigilTargetingRequestData& UVigilTargetSelection::GetRequestData(const FTargetingRequestHandle& TargetingHandle) const
+{
+	const FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	return RequestData && RequestData->bValid ? *RequestData : InitRequestData(TargetingHandle);
+}
+
 void UVigilTargetSelection::Execute(const FTargetingRequestHandle& TargetingHandle) const
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::Execute);
 	
 	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Executing);
 
+	// Resolve the source and evaluate the shape once, every other step and task reads this
+	InitRequestData(TargetingHandle);
+
 	// @note: There isn't Async Overlap support based on Primitive Component, so even if using async targeting, it will
 	// run this task in "immediate" mode.
 	if (IsAsyncTargetingRequest(TargetingHandle) && (ShapeType != EVigilTargetingShape::SourceComponent))
@@ -123,8 +239,9 @@ void UVigilTargetSelection::ExecuteImmediateTrace(const FTargetingRequestHandle&
 	const UWorld* World = GetSourceContextWorld(TargetingHandle);
 	if (World && TargetingHandle.IsValid())
 	{
-		const FVector SourceLocation = GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
-		const FQuat SourceRotation = (GetSourceRotation(TargetingHandle) * GetSourceRotationOffset(TargetingHandle)).GetNormalized();
+		const FVigilTargetingRequestData& RequestData = GetRequestData(TargetingHandle);
+		const FVector& SourceLocation = RequestData.SourceLocation;
+		const FQuat& SourceRotation = RequestData.SourceRotation;
 
 		TArray<FOverlapResult> OverlapResults;
 		if (ShapeType == EVigilTargetingShape::SourceComponent)
@@ -142,28 +259,29 @@ void UVigilTargetSelection::ExecuteImmediateTrace(const FTargetingRequestHandle&
 		}
 		else
 		{
-			const FCollisionShape CollisionShape = GetCollisionShape();
+			const FCollisionShape CollisionShape = GetCollisionShape(RequestData);
 			FCollisionQueryParams OverlapParams(TEXT("UVigilTargetSelection_AOE"), SCENE_QUERY_STAT_ONLY(UVigilTargetSelection_AOE), false);
 			InitCollisionParams(TargetingHandle, OverlapParams);
 
-			if (CollisionObjectTypes.Num() > 0)
+			// The immediate box is centered on the source, which covers the whole cone
+			FVigilTargetingRequestData& MutableRequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+			MutableRequestData.ConeBroadphaseBoxes.Reset();
+			if (ShouldUseConeBoxChain(RequestData))
 			{
-				FCollisionObjectQueryParams ObjectParams;
-				for (auto Iter = CollisionObjectTypes.CreateConstIterator(); Iter; ++Iter)
-				{
-					const ECollisionChannel& Channel = UCollisionProfile::Get()->ConvertToCollisionChannel(false, *Iter);
-					ObjectParams.AddObjectTypesToQuery(Channel);
-				}
-
-				World->OverlapMultiByObjectType(OverlapResults, SourceLocation, SourceRotation, ObjectParams, CollisionShape, OverlapParams);
+				BuildConeBoxChain(MutableRequestData, 0.f);
 			}
-			else if (CollisionProfileName.Name != TEXT("NoCollision"))
+
+			if (RequestData.ConeBroadphaseBoxes.Num() > 0)
 			{
-				World->OverlapMultiByProfile(OverlapResults, SourceLocation, SourceRotation, CollisionProfileName.Name, CollisionShape, OverlapParams);
+				for (const FVigilBroadphaseBox& Box : RequestData.ConeBroadphaseBoxes)
+				{
+					OverlapMulti(World, Box.Center, SourceRotation, FCollisionShape::MakeBox(Box.HalfExtent), OverlapParams, OverlapResults);
+				}
+				RemoveDuplicateOverlaps(OverlapResults);
 			}
 			else
 			{
-				World->OverlapMultiByChannel(OverlapResults, SourceLocation, SourceRotation, CollisionChannel, CollisionShape, OverlapParams);
+				OverlapMulti(World, SourceLocation, SourceRotation, CollisionShape, OverlapParams, OverlapResults);
 			}
 		}
 
@@ -189,43 +307,121 @@ void UVigilTargetSelection::ExecuteAsyncTrace(const FTargetingRequestHandle& Tar
 	UWorld* World = GetSourceContextWorld(TargetingHandle);
 	if (World && TargetingHandle.IsValid())
 	{
-		FVector SourceLocation = GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
-		const FQuat SourceRotation = (GetSourceRotation(TargetingHandle) * GetSourceRotationOffset(TargetingHandle)).GetNormalized();
+		const FVigilTargetingRequestData& RequestData = GetRequestData(TargetingHandle);
+		FVector SourceLocation = RequestData.SourceLocation;
+		const FQuat SourceRotation = RequestData.SourceRotation;
 
 		if (ShapeType == EVigilTargetingShape::Cone)
 		{
-			SourceLocation += SourceRotation.Vector() * ConeLength.GetValue() * 0.5f;
+			SourceLocation += RequestData.SourceDirection * RequestData.Cone.Length * 0.5f;
 		}
 
-		const FCollisionShape CollisionShape = GetCollisionShape();
-		FCollisionQueryParams OverlapParams(TEXT("UVigilTargetSelection_AOE"), SCENE_QUERY_STAT_ONLY(UVigilTargetSelection_AOE_Shape), false);
-		InitCollisionParams(TargetingHandle, OverlapParams);
-
-		const FOverlapDelegate Delegate = FOverlapDelegate::CreateUObject(this, &UVigilTargetSelection::HandleAsyncOverlapComplete, TargetingHandle);
-		if (CollisionObjectTypes.Num() > 0)
+		// Let the batcher group us with nearby requests, it will call HandleSharedOverlapComplete
+		if (CanShareBroadphase())
 		{
-			FCollisionObjectQueryParams ObjectParams;
-			for (auto Iter = CollisionObjectTypes.CreateConstIterator(); Iter; ++Iter)
+			if (UVigilBroadphaseBatcher* Batcher = UVigilBroadphaseBatcher::Get(World))
 			{
-				const ECollisionChannel& Channel = UCollisionProfile::Get()->ConvertToCollisionChannel(false, *Iter);
-				ObjectParams.AddObjectTypesToQuery(Channel);
+				const float BroadphaseRadius = GetCollisionShape(RequestData).GetExtent().Size();
+				Batcher->AddRequest(this, TargetingHandle, SourceLocation, SourceRotation, BroadphaseRadius);
+				return;
 			}
-
-			World->AsyncOverlapByObjectType(SourceLocation, SourceRotation, ObjectParams, CollisionShape, OverlapParams, &Delegate);
 		}
-		else if (CollisionProfileName.Name != TEXT("NoCollision"))
+
+		StartOwnAsyncOverlap(World, TargetingHandle, SourceLocation, SourceRotation);
+	}
+	else
+	{
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+	}
+}
+
+void UVigilTargetSelection::StartOwnAsyncOverlap(UWorld* World, const FTargetingRequestHandle& TargetingHandle,
+	const FVector& Location, const FQuat& Rotation) const
+{
+	const FCollisionShape CollisionShape = GetCollisionShape(GetRequestData(TargetingHandle));
+	FCollisionQueryParams OverlapParams(TEXT("UVigilTargetSelection_AOE"), SCENE_QUERY_STAT_ONLY(UVigilTargetSelection_AOE_Shape), false);
+	InitCollisionParams(TargetingHandle, OverlapParams);
+
+	FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(TargetingHandle);
+	RequestData.ConeBroadphaseBoxes.Reset();
+	if (ShouldUseConeBoxChain(RequestData))
+	{
+		// Only chain the part of the cone the single box would have overlapped
+		const float BoxForward = (Location - RequestData.ConeRear) | RequestData.SourceDirection;
+		BuildConeBoxChain(RequestData, FMath::Max(0.f, BoxForward - RequestData.Cone.Length * 0.5f));
+	}
+
+	if (RequestData.ConeBroadphaseBoxes.Num() > 0)
+	{
+		RequestData.PendingOverlaps.Reset();
+		RequestData.NumPendingOverlaps = RequestData.ConeBroadphaseBoxes.Num();
+
+		const FOverlapDelegate ChainDelegate = FOverlapDelegate::CreateUObject(this, &UVigilTargetSelection::HandleAsyncChainOverlapComplete, TargetingHandle);
+		for (const FVigilBroadphaseBox& Box : RequestData.ConeBroadphaseBoxes)
 		{
-			World->AsyncOverlapByProfile(SourceLocation, SourceRotation, CollisionProfileName.Name, CollisionShape, OverlapParams, &Delegate);
+			StartAsyncOverlap(World, Box.Center, Rotation, FCollisionShape::MakeBox(Box.HalfExtent), OverlapParams, ChainDelegate);
 		}
-		else
+		return;
+	}
+
+	const FOverlapDelegate Delegate = FOverlapDelegate::CreateUObject(this, &UVigilTargetSelection::HandleAsyncOverlapComplete, TargetingHandle);
+	StartAsyncOverlap(World, Location, Rotation, CollisionShape, OverlapParams, Delegate);
+}
+
+void UVigilTargetSelection::StartAsyncOverlap(UWorld* World, const FVector& Location, const FQuat& Rotation,
+	const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params, const FOverlapDelegate& Delegate) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::StartAsyncOverlap);
+	
+	if (CollisionObjectTypes.Num() > 0)
+	{
+		FCollisionObjectQueryParams ObjectParams;
+		for (auto Iter = CollisionObjectTypes.CreateConstIterator(); Iter; ++Iter)
 		{
-			World->AsyncOverlapByChannel(SourceLocation, SourceRotation, CollisionChannel, CollisionShape, OverlapParams, FCollisionResponseParams::DefaultResponseParam, &Delegate);
+			const ECollisionChannel& Channel = UCollisionProfile::Get()->ConvertToCollisionChannel(false, *Iter);
+			ObjectParams.AddObjectTypesToQuery(Channel);
 		}
+
+		World->AsyncOverlapByObjectType(Location, Rotation, ObjectParams, CollisionShape, Params, &Delegate);
+	}
+	else if (CollisionProfileName.Name != TEXT("NoCollision"))
+	{
+		World->AsyncOverlapByProfile(Location, Rotation, CollisionProfileName.Name, CollisionShape, Params, &Delegate);
 	}
 	else
 	{
-		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+		World->AsyncOverlapByChannel(Location, Rotation, CollisionChannel, CollisionShape, Params, FCollisionResponseParams::DefaultResponseParam, &Delegate);
+	}
+}
+
+void UVigilTargetSelection::HandleSharedOverlapComplete(const FTargetingRequestHandle& TargetingHandle,
+	const TArray<FOverlapResult>& Overlaps) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::HandleSharedOverlapComplete);
+	
+	if (TargetingHandle.IsValid())
+	{
+#if UE_ENABLE_DEBUG_DRAWING
+		ResetDebugString(TargetingHandle);
+#endif
+
+		if (StartAsyncTraceMesh(TargetingHandle, Overlaps, true))
+		{
+			return;
+		}
+
+		const int32 NumValidResults = ProcessOverlapResults(TargetingHandle, Overlaps, true);
+		
+#if UE_ENABLE_DEBUG_DRAWING
+		if (FVigilCVars::bVigilSelectionDebug)
+		{
+			const FColor& DebugColor = NumValidResults > 0 ? FColor::Red : FColor::Green;
+			DebugDrawBoundingVolume(TargetingHandle, DebugColor, FColor::Blue);
+		}
+#endif
 	}
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
 }
 
 void UVigilTargetSelection::HandleAsyncOverlapComplete(const FTraceHandle& InTraceHandle,
@@ -239,6 +435,11 @@ void UVigilTargetSelection::HandleAsyncOverlapComplete(const FTraceHandle& InTra
 		ResetDebugString(TargetingHandle);
 #endif
 
+		if (StartAsyncTraceMesh(TargetingHandle, InOverlapDatum.OutOverlaps, false))
+		{
+			return;
+		}
+
 		const int32 NumValidResults = ProcessOverlapResults(TargetingHandle, InOverlapDatum.OutOverlaps);
 		
 #if UE_ENABLE_DEBUG_DRAWING
@@ -254,8 +455,263 @@ void UVigilTargetSelection::HandleAsyncOverlapComplete(const FTraceHandle& InTra
 	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
 }
 
+void UVigilTargetSelection::HandleAsyncChainOverlapComplete(const FTraceHandle& InTraceHandle,
+	FOverlapDatum& InOverlapDatum, FTargetingRequestHandle TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::HandleAsyncChainOverlapComplete);
+
+	FVigilTargetingRequestData* RequestData = TargetingHandle.IsValid() ? FVigilTargetingRequestData::Find(TargetingHandle) : nullptr;
+	if (!RequestData)
+	{
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+		return;
+	}
+
+	// Wait for every box in the chain
+	RequestData->PendingOverlaps.Append(InOverlapDatum.OutOverlaps);
+	if (--RequestData->NumPendingOverlaps > 0)
+	{
+		return;
+	}
+
+	TArray<FOverlapResult> Overlaps = MoveTemp(RequestData->PendingOverlaps);
+	RemoveDuplicateOverlaps(Overlaps);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	ResetDebugString(TargetingHandle);
+#endif
+
+	if (StartAsyncTraceMesh(TargetingHandle, Overlaps, false))
+	{
+		return;
+	}
+
+	const int32 NumValidResults = ProcessOverlapResults(TargetingHandle, Overlaps);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilSelectionDebug)
+	{
+		const FColor& DebugColor = NumValidResults > 0 ? FColor::Red : FColor::Green;
+		const FColor& DebugColorAlt = Overlaps.Num() > 0 ? FColor::Red : FColor::Green;
+		DebugDrawBoundingVolume(TargetingHandle, DebugColor, DebugColorAlt);
+	}
+#endif
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+}
+
+bool UVigilTargetSelection::StartAsyncTraceMesh(const FTargetingRequestHandle& TargetingHandle,
+	const TArray<FOverlapResult>& Overlaps, bool bSharedBroadphase) const
+{
+	if (ShapeType != EVigilTargetingShape::Cone || ConeTargetSource != EVigilConeTargetLocationSource::TraceMesh)
+	{
+		return false;
+	}
+
+	UWorld* World = GetSourceContextWorld(TargetingHandle);
+	FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	if (!World || !RequestData || Overlaps.Num() == 0)
+	{
+		return false;
+	}
+
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::StartAsyncTraceMesh);
+
+	// Trace towards the component if it exists, otherwise the actor, the same as the immediate path
+	RequestData->TraceMeshOverlaps = Overlaps;
+	RequestData->TraceMeshLocations.Reset(Overlaps.Num());
+	RequestData->bTraceMeshSharedBroadphase = bSharedBroadphase;
+	for (const FOverlapResult& OverlapResult : Overlaps)
+	{
+		const UPrimitiveComponent* Component = OverlapResult.GetComponent();
+		const AActor* Actor = OverlapResult.GetActor();
+		RequestData->TraceMeshLocations.Add(Component ? Component->GetComponentLocation() : Actor ? Actor->GetActorLocation() : FVector::ZeroVector);
+	}
+
+	FCollisionQueryParams Params(TEXT("UVigilTargetSelection_AOE_ConeTargetMesh"),
+		SCENE_QUERY_STAT_ONLY(UVigilTargetSelection_AOE_ConeTargetMesh), true);
+	InitCollisionParams(TargetingHandle, Params);
+	Params.bTraceComplex = true;
+
+	// The overlap index is the trace's user data
+	const FTraceDelegate Delegate = FTraceDelegate::CreateUObject(this, &UVigilTargetSelection::HandleAsyncTraceMeshComplete, TargetingHandle);
+	RequestData->NumPendingTraceMeshTraces = 0;
+	for (int32 OverlapIndex = 0; OverlapIndex < Overlaps.Num(); ++OverlapIndex)
+	{
+		if (Overlaps[OverlapIndex].GetActor())
+		{
+			RequestData->NumPendingTraceMeshTraces++;
+			World->AsyncLineTraceByChannel(EAsyncTraceType::Single, RequestData->SourceLocation,
+				RequestData->TraceMeshLocations[OverlapIndex], ConeTargetCollisionChannel, Params,
+				FCollisionResponseParams::DefaultResponseParam, &Delegate, static_cast<uint32>(OverlapIndex));
+		}
+	}
+
+	return RequestData->NumPendingTraceMeshTraces > 0;
+}
+
+void UVigilTargetSelection::HandleAsyncTraceMeshComplete(const FTraceHandle& InTraceHandle, FTraceDatum& InTraceDatum,
+	FTargetingRequestHandle TargetingHandle) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::HandleAsyncTraceMeshComplete);
+
+	FVigilTargetingRequestData* RequestData = TargetingHandle.IsValid() ? FVigilTargetingRequestData::Find(TargetingHandle) : nullptr;
+	if (!RequestData || RequestData->NumPendingTraceMeshTraces <= 0)
+	{
+		SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+		return;
+	}
+
+	const int32 OverlapIndex = static_cast<int32>(InTraceDatum.UserData);
+	if (RequestData->TraceMeshLocations.IsValidIndex(OverlapIndex))
+	{
+		for (const FHitResult& Hit : InTraceDatum.OutHits)
+		{
+			if (Hit.bBlockingHit)  // We probably don't care about start penetrating?
+			{
+				RequestData->TraceMeshLocations[OverlapIndex] = Hit.ImpactPoint;
+				break;
+			}
+		}
+	}
+
+	// Wait for every trace
+	if (--RequestData->NumPendingTraceMeshTraces > 0)
+	{
+		return;
+	}
+
+	const TArray<FOverlapResult> Overlaps = MoveTemp(RequestData->TraceMeshOverlaps);
+	const TArray<FVector> TargetLocations = MoveTemp(RequestData->TraceMeshLocations);
+	const int32 NumValidResults = ProcessOverlapResults(TargetingHandle, Overlaps, RequestData->bTraceMeshSharedBroadphase, &TargetLocations);
+
+#if UE_ENABLE_DEBUG_DRAWING
+	if (FVigilCVars::bVigilSelectionDebug)
+	{
+		const FColor& DebugColor = NumValidResults > 0 ? FColor::Red : FColor::Green;
+		const FColor& DebugColorAlt = Overlaps.Num() > 0 ? FColor::Red : FColor::Green;
+		DebugDrawBoundingVolume(TargetingHandle, DebugColor, DebugColorAlt);
+	}
+#endif
+
+	SetTaskAsyncState(TargetingHandle, ETargetingTaskAsyncState::Completed);
+}
+
+bool UVigilTargetSelection::ShouldUseConeBoxChain(const FVigilTargetingRequestData& RequestData) const
+{
+	if (ShapeType != EVigilTargetingShape::Cone)
+	{
+		return false;
+	}
+
+	// A cone 180 degrees or wider is a box anyway
+	if (RequestData.ConeTanHalfWidth >= UE_BIG_NUMBER || RequestData.ConeTanHalfHeight >= UE_BIG_NUMBER)
+	{
+		return false;
+	}
+
+	switch (FVigilCVars::VigilSelectionConeBroadphase)
+	{
+	case 0: return false;
+	case 1: return true;
+	default: break;
+	}
+
+	switch (ConeBroadphase)
+	{
+	case EVigilConeBroadphase::Auto: return RequestData.Cone.Length >= FVigilCVars::VigilSelectionConeChainMinLength;
+	case EVigilConeBroadphase::BoxChain: return true;
+	case EVigilConeBroadphase::Box:
+	default: return false;
+	}
+}
+
+void UVigilTargetSelection::BuildConeBoxChain(FVigilTargetingRequestData& RequestData, float MinForward) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::BuildConeBoxChain);
+
+	RequestData.ConeBroadphaseBoxes.Reset();
+
+	const int32 NumSegments = FMath::Clamp(ConeChainSegments, 2, 8);
+	const float SegmentLength = (RequestData.Cone.Length - MinForward) / NumSegments;
+	if (SegmentLength <= 0.f)
+	{
+		return;
+	}
+
+	// Each box bounds its slice of the cone, which is widest at the far end of the slice
+	for (int32 Segment = 0; Segment < NumSegments; Segment++)
+	{
+		const float Near = MinForward + Segment * SegmentLength;
+		const float Far = Near + SegmentLength;
+		const FVector Center = RequestData.ConeRear + RequestData.SourceDirection * (0.5f * (Near + Far));
+		const FVector BoxHalfExtent(0.5f * SegmentLength, Far * RequestData.ConeTanHalfWidth, Far * RequestData.ConeTanHalfHeight);
+		RequestData.ConeBroadphaseBoxes.Emplace(Center, BoxHalfExtent);
+	}
+}
+
+void UVigilTargetSelection::OverlapMulti(const UWorld* World, const FVector& Location, const FQuat& Rotation,
+	const FCollisionShape& CollisionShape, const FCollisionQueryParams& Params, TArray<FOverlapResult>& OutOverlaps) const
+{
+	TArray<FOverlapResult> Overlaps;
+	if (CollisionObjectTypes.Num() > 0)
+	{
+		FCollisionObjectQueryParams ObjectParams;
+		for (auto Iter = CollisionObjectTypes.CreateConstIterator(); Iter; ++Iter)
+		{
+			const ECollisionChannel& Channel = UCollisionProfile::Get()->ConvertToCollisionChannel(false, *Iter);
+			ObjectParams.AddObjectTypesToQuery(Channel);
+		}
+
+		World->OverlapMultiByObjectType(Overlaps, Location, Rotation, ObjectParams, CollisionShape, Params);
+	}
+	else if (CollisionProfileName.Name != TEXT("NoCollision"))
+	{
+		World->OverlapMultiByProfile(Overlaps, Location, Rotation, CollisionProfileName.Name, CollisionShape, Params);
+	}
+	else
+	{
+		World->OverlapMultiByChannel(Overlaps, Location, Rotation, CollisionChannel, CollisionShape, Params);
+	}
+	OutOverlaps.Append(MoveTemp(Overlaps));
+}
+
+void UVigilTargetSelection::RemoveDuplicateOverlaps(TArray<FOverlapResult>& Overlaps)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::RemoveDuplicateOverlaps);
+
+	TSet<TPair<const UPrimitiveComponent*, int32>> Seen;
+	Seen.Reserve(Overlaps.Num());
+
+	int32 NumUnique = 0;
+	for (int32 i = 0; i < Overlaps.Num(); i++)
+	{
+		bool bDuplicate = false;
+		Seen.Add({ Overlaps[i].GetComponent(), Overlaps[i].ItemIndex }, &bDuplicate);
+		if (!bDuplicate)
+		{
+			if (NumUnique != i)
+			{
+				Overlaps[NumUnique] = MoveTemp(Overlaps[i]);
+			}
+			NumUnique++;
+		}
+	}
+	Overlaps.SetNum(NumUnique);
+}
+
+void UVigilTargetSelection::RecordConeBroadphaseStats(const FVigilTargetingRequestData& RequestData, int32 NumCandidates,
+	int32 NumAccepted) const
+{
+	VigilSelectionStats::FConeBroadphaseStats& Stats = RequestData.ConeBroadphaseBoxes.Num() > 0 ?
+		VigilSelectionStats::BoxChain : VigilSelectionStats::Box;
+	Stats.Requests++;
+	Stats.Candidates += NumCandidates;
+	Stats.Accepted += NumAccepted;
+}
+
 int32 UVigilTargetSelection::ProcessOverlapResults(const FTargetingRequestHandle& TargetingHandle,
-	const TArray<FOverlapResult>& Overlaps) const
+	const TArray<FOverlapResult>& Overlaps, bool bSharedBroadphase, const TArray<FVector>* ConeTargetLocations) const
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::ProcessOverlapResults);
 	
@@ -264,31 +720,49 @@ int32 UVigilTargetSelection::ProcessOverlapResults(const FTargetingRequestHandle
 	if (Overlaps.Num() > 0)
 	{
 		FTargetingDefaultResultsSet& TargetingResults = FTargetingDefaultResultsSet::FindOrAdd(TargetingHandle);
-		const FVector SourceLocation = GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
-		const FQuat SourceRotation = (GetSourceRotation(TargetingHandle) * GetSourceRotationOffset(TargetingHandle)).GetNormalized();
+		const FVigilTargetingRequestData& RequestData = GetRequestData(TargetingHandle);
+		const FVector& SourceLocation = RequestData.SourceLocation;
+
+		// Shared overlaps don't ignore anyone, apply our own ignored actors
+		const AActor* IgnoredSourceActor = nullptr;
+		const AActor* IgnoredInstigatorActor = nullptr;
+		if (bSharedBroadphase)
+		{
+			if (const FTargetingSourceContext* SourceContext = FTargetingSourceContext::Find(TargetingHandle))
+			{
+				IgnoredSourceActor = bIgnoreSourceActor ? SourceContext->SourceActor : nullptr;
+				IgnoredInstigatorActor = bIgnoreInstigatorActor ? SourceContext->InstigatorActor : nullptr;
+			}
+		}
+
+		// Gather the candidates relative to the origin of the shape they are tested against
+		const bool bCone = ShapeType == EVigilTargetingShape::Cone;
+		const bool bCylinder = ShapeType == EVigilTargetingShape::Cylinder;
+		const FVector ShapeOrigin = bCone ? RequestData.ConeRear : SourceLocation;
 
-		for (const FOverlapResult& OverlapResult : Overlaps)
+		FVigilCandidateBuffer Candidates;
+		Candidates.Reset(Overlaps.Num());
+		for (int32 OverlapIndex = 0; OverlapIndex < Overlaps.Num(); ++OverlapIndex)
 		{
+			const FOverlapResult& OverlapResult = Overlaps[OverlapIndex];
 			if (!OverlapResult.GetActor())
 			{
 				continue;
 			}
 
-			// cylinders use box overlaps, so a radius check is necessary to constrain it to the bounds of a cylinder
-			if (ShapeType == EVigilTargetingShape::Cylinder)
+			if (bSharedBroadphase && (OverlapResult.GetActor() == IgnoredSourceActor || OverlapResult.GetActor() == IgnoredInstigatorActor))
 			{
-				const float RadiusSquared = (HalfExtent.X * HalfExtent.X);
-				const float DistanceSquared = FVector::DistSquared2D(OverlapResult.GetActor()->GetActorLocation(), SourceLocation);
-				if (DistanceSquared > RadiusSquared)
-				{
-					continue;
-				}
+				continue;
 			}
 
-			// cone use box overlaps, so a length and angle check is necessary to constrain it to the bounds of a cone
-			if (ShapeType == EVigilTargetingShape::Cone)
+			FVector TargetLocation = OverlapResult.GetActor()->GetActorLocation();
+			if (bCone && ConeTargetLocations && ConeTargetLocations->IsValidIndex(OverlapIndex))
+			{
+				// Already resolved, e.g. by async TraceMesh traces
+				TargetLocation = (*ConeTargetLocations)[OverlapIndex];
+			}
+			else if (bCone)
 			{
-				FVector TargetLocation = OverlapResult.GetActor()->GetActorLocation();
 				switch (ConeTargetSource)
 				{
 				case EVigilConeTargetLocationSource::Component:
@@ -323,28 +797,44 @@ int32 UVigilTargetSelection::ProcessOverlapResults(const FTargetingRequestHandle
 					}
 					break;
 				}
-
-				const FVector SourceDirection = SourceRotation.Vector();
-				const FVector ConeRear = SourceLocation - SourceDirection * (GetConeShape().Length * 0.5f);
-				if (!GetConeShape().IsPointWithinCone(TargetLocation, ConeRear, SourceDirection))
-				{
-					continue;
-				}
 			}
 
-			bool bAddResult = true;
-			if (!bTraceMultipleComponentsPerActor)
+			Candidates.Add(TargetLocation - ShapeOrigin, OverlapIndex);
+		}
+
+		if (bCylinder)
+		{
+			// cylinders use box overlaps, so a radius check is necessary to constrain it to the bounds of a cylinder
+			// Shared overlaps are spheres, so the height isn't constrained by a box either
+			Candidates.TestCylinder(RequestData.HalfExtent.X, RequestData.HalfExtent.Z, bSharedBroadphase);
+		}
+		else if (bCone)
+		{
+			// cone use box overlaps, so a length and angle check is necessary to constrain it to the bounds of a cone
+			Candidates.TestCone(RequestData.SourceDirection, RequestData.ConeRight, RequestData.ConeUp,
+				RequestData.Cone.Length, RequestData.ConeTanHalfWidth, RequestData.ConeTanHalfHeight);
+		}
+
+		// Reduce each actor to a single component, before any filter or sort has to process the others
+		TMap<const AActor*, int32> ActorCandidates;
+		if (!bTraceMultipleComponentsPerActor)
+		{
+			ReduceComponentsPerActor(RequestData, TargetingResults.TargetResults, Overlaps, Candidates, ShapeOrigin,
+				bCone || bCylinder, ActorCandidates);
+		}
+
+		for (int32 CandidateIndex = 0; CandidateIndex < Candidates.Num(); ++CandidateIndex)
+		{
+			if ((bCone || bCylinder) && !Candidates.Inside[CandidateIndex])
 			{
-				for (const FTargetingDefaultResultData& ResultData : TargetingResults.TargetResults)
-				{
-					if (ResultData.HitResult.GetActor() == OverlapResult.GetActor())
-					{
-						bAddResult = false;
-						break;
-					}
-				}
+				continue;
 			}
 
+			const FOverlapResult& OverlapResult = Overlaps[Candidates.SourceIndices[CandidateIndex]];
+
+			const bool bAddResult = bTraceMultipleComponentsPerActor ||
+				ActorCandidates.FindRef(OverlapResult.GetActor(), INDEX_NONE) == CandidateIndex;
+
 			if (bAddResult)
 			{
 				NumValidResults++;
@@ -355,57 +845,20 @@ int32 UVigilTargetSelection::ProcessOverlapResults(const FTargetingRequestHandle
 				ResultData->HitResult.ImpactPoint = OverlapResult.GetComponent()->GetComponentLocation();
 				ResultData->HitResult.Location = OverlapResult.GetActor()->GetActorLocation();
 				ResultData->HitResult.bBlockingHit = OverlapResult.bBlockingHit;
-				ResultData->HitResult.TraceStart = SourceLocation;
 				ResultData->HitResult.Item = OverlapResult.ItemIndex;
 				ResultData->HitResult.Distance = FVector::Distance(OverlapResult.GetActor()->GetActorLocation(), SourceLocation);
 
-				// Store the normal based on where we are looking based on source rotation
-				ResultData->HitResult.Normal = SourceRotation.Vector();
-
-				// Store the trace radius into Time based on the shape type
-				switch (ShapeType)
-				{
-				case EVigilTargetingShape::Cone:
-					ResultData->HitResult.Time = FMath::Max(GetConeShape().AngleHeight, GetConeShape().AngleWidth);
-					break;
-				case EVigilTargetingShape::Box:
-				case EVigilTargetingShape::Cylinder:
-					ResultData->HitResult.Time = FMath::Max3(HalfExtent.X, HalfExtent.Y, HalfExtent.Z);
-					break;
-				case EVigilTargetingShape::Sphere:
-					ResultData->HitResult.Time = Radius.GetValue();
-					break;
-				case EVigilTargetingShape::Capsule:
-					ResultData->HitResult.Time = HalfHeight.GetValue();
-					break;
-				case EVigilTargetingShape::SourceComponent:
-					ResultData->HitResult.Time = Radius.GetValue();
-					break;
-				}
-
-				// Store the max distance into PenetrationDepth based on the shape type
-				switch (ShapeType)
-				{
-				case EVigilTargetingShape::Cone:
-					ResultData->HitResult.PenetrationDepth = GetConeShape().Length;
-					break;
-				case EVigilTargetingShape::Box:
-				case EVigilTargetingShape::Cylinder:
-					ResultData->HitResult.PenetrationDepth = FMath::Max3(HalfExtent.X, HalfExtent.Y, HalfExtent.Z);
-					break;
-				case EVigilTargetingShape::Sphere:
-					ResultData->HitResult.PenetrationDepth = Radius.GetValue();
-					break;
-				case EVigilTargetingShape::Capsule:
-					ResultData->HitResult.PenetrationDepth = HalfHeight.GetValue();
-					break;
-				case EVigilTargetingShape::SourceComponent:
-					ResultData->HitResult.PenetrationDepth = Radius.GetValue();
-					break;
-				}
+				// Store the source, direction, max angle and max distance for anything that only has the hit result
+				RequestData.WriteToHitResult(ResultData->HitResult);
 			}
 		}
 
+		// Shared overlaps are spheres rather than our own broadphase
+		if (bCone && !bSharedBroadphase)
+		{
+			RecordConeBroadphaseStats(RequestData, Candidates.Num(), NumValidResults);
+		}
+
 #if UE_ENABLE_DEBUG_DRAWING
 		BuildDebugString(TargetingHandle, TargetingResults.TargetResults);
 #endif
@@ -414,6 +867,81 @@ int32 UVigilTargetSelection::ProcessOverlapResults(const FTargetingRequestHandle
 	return NumValidResults;
 }
 
+void UVigilTargetSelection::ReduceComponentsPerActor(const FVigilTargetingRequestData& RequestData,
+	const TArray<FTargetingDefaultResultData>& ExistingResults, const TArray<FOverlapResult>& Overlaps,
+	const FVigilCandidateBuffer& Candidates, const FVector& ShapeOrigin, bool bTestedCandidates,
+	TMap<const AActor*, int32>& OutActorCandidates) const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::ReduceComponentsPerActor);
+
+	// Actors that already have a result, e.g. from another selection task, don't get another
+	TSet<const AActor*> ExistingActors;
+	ExistingActors.Reserve(ExistingResults.Num());
+	for (const FTargetingDefaultResultData& ResultData : ExistingResults)
+	{
+		ExistingActors.Add(ResultData.HitResult.GetActor());
+	}
+
+	// Score of each actor's best candidate, higher is better, focus components beat any score
+	TMap<const AActor*, TPair<bool, float>> BestScores;
+	OutActorCandidates.Reset();
+	OutActorCandidates.Reserve(Candidates.Num());
+	BestScores.Reserve(Candidates.Num());
+
+	for (int32 CandidateIndex = 0; CandidateIndex < Candidates.Num(); ++CandidateIndex)
+	{
+		if (bTestedCandidates && !Candidates.Inside[CandidateIndex])
+		{
+			continue;
+		}
+
+		const FOverlapResult& OverlapResult = Overlaps[Candidates.SourceIndices[CandidateIndex]];
+		const AActor* Actor = OverlapResult.GetActor();
+		if (ExistingActors.Contains(Actor))
+		{
+			continue;
+		}
+
+		// Candidates are stored relative to the shape origin
+		const FVector ToCandidate = FVector(Candidates.X[CandidateIndex], Candidates.Y[CandidateIndex],
+			Candidates.Z[CandidateIndex]) + ShapeOrigin - RequestData.SourceLocation;
+
+		bool bFocus = false;
+		float Score = 0.f;
+		switch (ComponentReduction)
+		{
+		case EVigilComponentReduction::First:
+			break;
+		case EVigilComponentReduction::Closest:
+			Score = -ToCandidate.SizeSquared();
+			break;
+		case EVigilComponentReduction::BestAngle:
+			Score = RequestData.SourceDirection | ToCandidate.GetSafeNormal();
+			break;
+		case EVigilComponentReduction::FocusComponent:
+			{
+				// Tagged components always beat untagged, otherwise the closest
+				const UPrimitiveComponent* Component = OverlapResult.GetComponent();
+				bFocus = Component && Component->ComponentHasTag(FocusComponentTag);
+				Score = -ToCandidate.SizeSquared();
+			}
+			break;
+		}
+
+		TPair<bool, float>* BestScore = BestScores.Find(Actor);
+		if (!BestScore)
+		{
+			BestScores.Add(Actor, { bFocus, Score });
+			OutActorCandidates.Add(Actor, CandidateIndex);
+		}
+		else if (bFocus != BestScore->Key ? bFocus : Score > BestScore->Value)
+		{
+			*BestScore = { bFocus, Score };
+			OutActorCandidates[Actor] = CandidateIndex;
+		}
+	}
+}
+
 FCollisionShape UVigilTargetSelection::GetCollisionShape() const
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetSelection::GetCollisionShape);
@@ -430,6 +958,20 @@ FCollisionShape UVigilTargetSelection::GetCollisionShape() const
 	}
 }
 
+FCollisionShape UVigilTargetSelection::GetCollisionShape(const FVigilTargetingRequestData& RequestData) const
+{
+	switch (ShapeType)
+	{
+	case EVigilTargetingShape::Cone: return FCollisionShape::MakeBox(RequestData.Cone.GetConeBoxShapeHalfExtent());
+	case EVigilTargetingShape::Box:	return FCollisionShape::MakeBox(RequestData.HalfExtent);
+	case EVigilTargetingShape::Cylinder: return FCollisionShape::MakeBox(RequestData.HalfExtent);
+	case EVigilTargetingShape::Sphere: return FCollisionShape::MakeSphere(RequestData.Radius);
+	case EVigilTargetingShape::Capsule:
+		return FCollisionShape::MakeCapsule(RequestData.Radius, RequestData.HalfHeight);
+	default: return {};
+	}
+}
+
 const UPrimitiveComponent* UVigilTargetSelection::GetCollisionComponent(
 	const FTargetingRequestHandle& TargetingHandle) const
 {
@@ -467,9 +1009,10 @@ void UVigilTargetSelection::DebugDrawBoundingVolume(const FTargetingRequestHandl
 {
 #if UE_ENABLE_DEBUG_DRAWING
 	const UWorld* World = GetSourceContextWorld(TargetingHandle);
-	const FVector SourceLocation = OverlapDatum ? OverlapDatum->Pos : GetSourceLocation(TargetingHandle) + GetSourceOffset(TargetingHandle);
-	const FQuat SourceRotation = OverlapDatum ? OverlapDatum->Rot : (GetSourceRotation(TargetingHandle) * GetSourceRotationOffset(TargetingHandle)).GetNormalized();
-	const FCollisionShape CollisionShape = GetCollisionShape();
+	const FVigilTargetingRequestData& RequestData = GetRequestData(TargetingHandle);
+	const FVector SourceLocation = OverlapDatum ? OverlapDatum->Pos : RequestData.SourceLocation;
+	const FQuat SourceRotation = OverlapDatum ? OverlapDatum->Rot : RequestData.SourceRotation;
+	const FCollisionShape CollisionShape = GetCollisionShape(RequestData);
 
 	constexpr bool bPersistentLines = false;
 #if UE_5_04_OR_LATER
@@ -483,10 +1026,21 @@ void UVigilTargetSelection::DebugDrawBoundingVolume(const FTargetingRequestHandl
 	switch (ShapeType)
 	{
 	case EVigilTargetingShape::Cone:
-		UVigilStatics::DrawVigilDebugCone(World, SourceLocation - SourceRotation.Vector() * ConeLength.GetValue() * 0.5f, SourceRotation.Rotator(), GetConeShape(),
+		UVigilStatics::DrawVigilDebugCone(World, SourceLocation - SourceRotation.Vector() * RequestData.Cone.Length * 0.5f, SourceRotation.Rotator(), RequestData.Cone,
 			Color, 16, LifeTime, Thickness);
-		DrawDebugBox(World, SourceLocation, CollisionShape.GetExtent(), SourceRotation, ColorAlt, bPersistentLines,
-			LifeTime, DepthPriority, Thickness);
+		if (RequestData.ConeBroadphaseBoxes.Num() > 0)
+		{
+			for (const FVigilBroadphaseBox& Box : RequestData.ConeBroadphaseBoxes)
+			{
+				DrawDebugBox(World, Box.Center, Box.HalfExtent, RequestData.SourceRotation, ColorAlt, bPersistentLines,
+					LifeTime, DepthPriority, Thickness);
+			}
+		}
+		else
+		{
+			DrawDebugBox(World, SourceLocation, CollisionShape.GetExtent(), SourceRotation, ColorAlt, bPersistentLines,
+				LifeTime, DepthPriority, Thickness);
+		}
 		break;
 	case EVigilTargetingShape::Box:
 		DrawDebugBox(World, SourceLocation, CollisionShape.GetExtent(), SourceRotation,
@@ -4,6 +4,7 @@
 #include "Targeting/VigilTargetingStatics.h"
 
 #include "Targeting/VigilTargetingTypes.h"
+#include "VigilStatics.h"
 #include "Types/TargetingSystemTypes.h"
 #include "GameFramework/Pawn.h"
 #include "GameFramework/PlayerController.h"
@@ -162,6 +163,60 @@ FQuat UVigilTargetingStatics::GetSourceRotation(const FTargetingRequestHandle& T
 	return FQuat::Identity;
 }
 
+float UVigilTargetingStatics::GetDistanceToVigilTarget(const FTargetingRequestHandle& TargetingHandle,
+	const FHitResult& HitResult, float& NormalizedDistance, float& MaxDistance)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetingStatics::GetDistanceToVigilTarget);
+
+	const FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	if (!RequestData || !RequestData->bValid)
+	{
+		return UVigilStatics::GetDistanceToVigilTarget(HitResult, NormalizedDistance, MaxDistance);
+	}
+
+	MaxDistance = RequestData->MaxDistance;
+	return RequestData->GetDistanceToTarget(HitResult.ImpactPoint, NormalizedDistance);
+}
+
+float UVigilTargetingStatics::GetAngleToVigilTarget(const FTargetingRequestHandle& TargetingHandle,
+	const FHitResult& HitResult, float& NormalizedAngle, float& MaxAngle)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetingStatics::GetAngleToVigilTarget);
+
+	const FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	if (!RequestData || !RequestData->bValid)
+	{
+		return UVigilStatics::GetAngleToVigilTarget(HitResult, NormalizedAngle, MaxAngle);
+	}
+
+	MaxAngle = RequestData->MaxAngle;
+	return RequestData->GetAngleToTarget(HitResult.ImpactPoint, NormalizedAngle);
+}
+
+FVigilTargetMetrics UVigilTargetingStatics::GetVigilTargetMetrics(const FTargetingRequestHandle& TargetingHandle,
+	const FTargetingDefaultResultData& TargetData, bool bNeedAngle)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilTargetingStatics::GetVigilTargetMetrics);
+
+	FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(TargetingHandle);
+	const FTargetingDefaultResultsSet* Results = FTargetingDefaultResultsSet::Find(TargetingHandle);
+	if (RequestData && RequestData->bValid && Results)
+	{
+		if (const FVigilTargetMetrics* Metrics = RequestData->GetCandidateMetrics(Results->TargetResults, TargetData, bNeedAngle))
+		{
+			return *Metrics;
+		}
+		return RequestData->ComputeMetrics(TargetData.HitResult.ImpactPoint, bNeedAngle);
+	}
+
+	FVigilTargetMetrics Metrics;
+	Metrics.Distance = UVigilStatics::GetDistanceToVigilTarget(TargetData.HitResult, Metrics.NormalizedDistance, Metrics.MaxDistance);
+	Metrics.Angle = UVigilStatics::GetAngleToVigilTarget(TargetData.HitResult, Metrics.NormalizedAngle, Metrics.MaxAngle);
+	Metrics.AngleCos = FMath::Cos(FMath::DegreesToRadians(Metrics.Angle));
+	Metrics.bHasAngle = true;
+	return Metrics;
+}
+
 void UVigilTargetingStatics::InitCollisionParams(const FTargetingRequestHandle& TargetingHandle,
 	FCollisionQueryParams& OutParams, bool bIgnoreSourceActor, bool bIgnoreInstigatorActor, bool bTraceComplex)
 {
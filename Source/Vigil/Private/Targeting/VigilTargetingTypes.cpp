@@ -0,0 +1,177 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Targeting/VigilTargetingTypes.h"
+
+#include "Components/PrimitiveComponent.h"
+#include "SceneView.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(VigilTargetingTypes)
+
+DEFINE_TARGETING_DATA_STORE(FVigilTargetingRequestData)
+
+bool FVigilScreenProjection::Project(const FVector& WorldLocation, FVector2D& OutScreenLocation) const
+{
+	if (!bValid || !FSceneView::ProjectWorldToScreen(WorldLocation, ViewRect, ViewProjectionMatrix, OutScreenLocation))
+	{
+		return false;
+	}
+
+	// Relative to the player's view, same as APlayerController::ProjectWorldLocationToScreen
+	OutScreenLocation -= FVector2D(ViewRect.Min);
+	return true;
+}
+
+float FVigilTargetingRequestData::GetDistanceToTarget(const FVector& TargetLocation, float& NormalizedDistance) const
+{
+	const float Distance = FVector::Distance(SourceLocation, TargetLocation);
+	NormalizedDistance = MaxDistance > 0.f ? FMath::Clamp(Distance / MaxDistance, 0.f, 1.f) : 0.f;
+	return Distance;
+}
+
+float FVigilTargetingRequestData::GetAngleToTarget(const FVector& TargetLocation, float& NormalizedAngle) const
+{
+	const FVector Direction = (TargetLocation - SourceLocation).GetSafeNormal();
+	const float AngleDot = FMath::Clamp(SourceDirection | Direction, -1.f, 1.f);
+	const float AngleDiff = FMath::RadiansToDegrees(FMath::Acos(AngleDot));
+	NormalizedAngle = MaxAngle > 0.f ? FMath::Clamp(AngleDiff / MaxAngle, 0.f, 1.f) : 0.f;
+	return AngleDiff;
+}
+
+void FVigilTargetingRequestData::WriteToHitResult(FHitResult& HitResult) const
+{
+	HitResult.TraceStart = SourceLocation;
+	HitResult.Normal = SourceDirection;
+	HitResult.Time = MaxAngle;
+	HitResult.PenetrationDepth = MaxDistance;
+}
+
+FVigilTargetMetrics FVigilTargetingRequestData::ComputeMetrics(const FVector& TargetLocation, bool bComputeAngle) const
+{
+	FVigilTargetMetrics Metrics;
+	Metrics.bValid = true;
+	Metrics.MaxDistance = MaxDistance;
+	Metrics.MaxAngle = MaxAngle;
+
+	// One square root gives us both the distance and the direction
+	const FVector Delta = TargetLocation - SourceLocation;
+	Metrics.Distance = Delta.Size();
+	Metrics.NormalizedDistance = MaxDistance > 0.f ? FMath::Clamp(Metrics.Distance / MaxDistance, 0.f, 1.f) : 0.f;
+	Metrics.AngleCos = Metrics.Distance > UE_SMALL_NUMBER ? FMath::Clamp((SourceDirection | Delta) / Metrics.Distance, -1.f, 1.f) : 0.f;
+
+	if (bComputeAngle)
+	{
+		EnsureAngle(Metrics);
+	}
+	return Metrics;
+}
+
+void FVigilTargetingRequestData::EnsureAngle(FVigilTargetMetrics& Metrics) const
+{
+	if (!Metrics.bHasAngle)
+	{
+		Metrics.Angle = FMath::RadiansToDegrees(FMath::Acos(Metrics.AngleCos));
+		Metrics.NormalizedAngle = MaxAngle > 0.f ? FMath::Clamp(Metrics.Angle / MaxAngle, 0.f, 1.f) : 0.f;
+		Metrics.bHasAngle = true;
+	}
+}
+
+FVigilTargetMetrics* FVigilTargetingRequestData::GetCandidateMetrics(const TArray<FTargetingDefaultResultData>& TargetResults,
+	const FTargetingDefaultResultData& TargetData, bool bNeedAngle)
+{
+	const FObjectKey Key = GetCandidateKey(TargetData);
+
+	// Sort tasks pass us the result itself, so its address gives us the index
+	const FTargetingDefaultResultData* First = TargetResults.GetData();
+	int32 Index = &TargetData >= First && &TargetData < First + TargetResults.Num() ?
+		static_cast<int32>(&TargetData - First) : INDEX_NONE;
+
+	if (CandidateKeys.Num() != TargetResults.Num() || (Index != INDEX_NONE && CandidateKeys[Index] != Key))
+	{
+		SyncCandidateMetrics(TargetResults);
+	}
+
+	// Not part of the results, but it may be a copy of one of them
+	if (Index == INDEX_NONE)
+	{
+		Index = CandidateKeys.IndexOfByKey(Key);
+		if (Index == INDEX_NONE)
+		{
+			return nullptr;
+		}
+	}
+
+	FVigilTargetMetrics& Metrics = CandidateMetrics[Index];
+	if (bNeedAngle)
+	{
+		EnsureAngle(Metrics);
+	}
+	return &Metrics;
+}
+
+bool FVigilTargetingRequestData::IsAlignedWith(const TArray<FTargetingDefaultResultData>& TargetResults) const
+{
+	if (CandidateKeys.Num() != TargetResults.Num())
+	{
+		return false;
+	}
+	for (int32 i = 0; i < TargetResults.Num(); i++)
+	{
+		if (CandidateKeys[i] != GetCandidateKey(TargetResults[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FVigilTargetingRequestData::SyncCandidateMetrics(const TArray<FTargetingDefaultResultData>& TargetResults)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FVigilTargetingRequestData::SyncCandidateMetrics);
+
+	// Keep anything we already computed, filters only remove results and sorts only reorder them
+	TMap<FObjectKey, FVigilTargetMetrics> Existing;
+	Existing.Reserve(CandidateKeys.Num());
+	for (int32 i = 0; i < CandidateKeys.Num(); i++)
+	{
+		Existing.Add(CandidateKeys[i], CandidateMetrics[i]);
+	}
+
+	CandidateKeys.Reset(TargetResults.Num());
+	CandidateMetrics.Reset(TargetResults.Num());
+	for (const FTargetingDefaultResultData& TargetData : TargetResults)
+	{
+		const FObjectKey Key = GetCandidateKey(TargetData);
+		const FVigilTargetMetrics* Metrics = Existing.Find(Key);
+		CandidateKeys.Add(Key);
+		CandidateMetrics.Add(Metrics ? *Metrics : ComputeMetrics(TargetData.HitResult.ImpactPoint));
+	}
+}
+
+void FVigilTargetingRequestData::PermuteCandidateMetrics(const TArray<int32>& NewOrder)
+{
+	if (!ensure(NewOrder.Num() <= CandidateMetrics.Num()))
+	{
+		return;
+	}
+
+	TArray<FVigilTargetMetrics> PrevMetrics = MoveTemp(CandidateMetrics);
+	TArray<FObjectKey> PrevKeys = MoveTemp(CandidateKeys);
+	CandidateMetrics.Reset(NewOrder.Num());
+	CandidateKeys.Reset(NewOrder.Num());
+	for (const int32 PrevIndex : NewOrder)
+	{
+		CandidateMetrics.Add(PrevMetrics[PrevIndex]);
+		CandidateKeys.Add(PrevKeys[PrevIndex]);
+	}
+}
+
+FObjectKey FVigilTargetingRequestData::GetCandidateKey(const FTargetingDefaultResultData& TargetData)
+{
+	// Multiple components per actor can be selected, so key by component when we have one
+	if (const UPrimitiveComponent* Component = TargetData.HitResult.GetComponent())
+	{
+		return FObjectKey(Component);
+	}
+	return FObjectKey(TargetData.HitResult.GetActor());
+}
@@ -0,0 +1,147 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Filtering/VigilFilter_LOSAsync.h"
+#include "Targeting/VigilTargetingTypes.h"
+#include "TargetingSystem/TargetingSubsystem.h"
+#include "Types/TargetingSystemDataStores.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Math/RandomStream.h"
+#include "UObject/Package.h"
+
+namespace VigilFilterTests
+{
+	template<typename T>
+	static void SetPropertyValue(UObject* Object, const TCHAR* PropertyName, const T& Value)
+	{
+		const FProperty* Property = FindFProperty<FProperty>(Object->GetClass(), PropertyName);
+		if (Property && Property->GetSize() == sizeof(T))
+		{
+			*Property->ContainerPtrToValuePtr<T>(Object) = Value;
+		}
+	}
+
+	static AStaticMeshActor* SpawnCube(UWorld* World, UStaticMesh* Mesh, const FVector& Location, const FVector& Scale,
+		EComponentMobility::Type Mobility)
+	{
+		// Static meshes can't be changed once registered, so set it up before spawning finishes
+		const FTransform Transform(FQuat::Identity, Location, Scale);
+		AStaticMeshActor* Actor = World->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), Transform);
+		Actor->GetStaticMeshComponent()->SetMobility(Mobility);
+		Actor->GetStaticMeshComponent()->SetStaticMesh(Mesh);
+		Actor->FinishSpawning(Transform);
+		return Actor;
+	}
+
+	static FTargetingRequestHandle MakeRequest(AActor* SourceActor, const TArray<AStaticMeshActor*>& Targets)
+	{
+		const FTargetingRequestHandle Handle = UTargetingSubsystem::MakeTargetRequestHandle(nullptr, FTargetingSourceContext { SourceActor });
+
+		FTargetingDefaultResultsSet& Results = FTargetingDefaultResultsSet::FindOrAdd(Handle);
+		for (AStaticMeshActor* Target : Targets)
+		{
+			FTargetingDefaultResultData& Result = Results.TargetResults.AddDefaulted_GetRef();
+			Result.HitResult = FHitResult(Target, Target->GetStaticMeshComponent(), Target->GetActorLocation(), FVector::UpVector);
+		}
+		return Handle;
+	}
+
+	static bool IsAsyncFilterPending(const FTargetingRequestHandle& Handle, const UObject* Filter)
+	{
+		const FVigilTargetingRequestData* RequestData = FVigilTargetingRequestData::Find(Handle);
+		return RequestData && RequestData->AsyncFilterStates.Contains(FObjectKey(Filter));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVigilFilterLOSAsyncTest, "Vigil.Filter.LOSAsync", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FVigilFilterLOSAsyncTest::RunTest(const FString& Parameters)
+{
+	using namespace VigilFilterTests;
+
+	UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (!TestNotNull(TEXT("Cube mesh"), Cube))
+	{
+		return false;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false);
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	// The source is at the origin, with a wall in front of it hiding some of the targets
+	AActor* SourceActor = World->SpawnActor<AActor>();
+	SpawnCube(World, Cube, FVector(500.f, 0.f, 0.f), FVector(0.2f, 10.f, 10.f), EComponentMobility::Static);
+
+	// Movable targets are ignored by the trace by default, static targets must be hit by it
+	FRandomStream Stream(14);
+	TArray<AStaticMeshActor*> Targets;
+	while (Targets.Num() < 64)
+	{
+		const FVector Location(Stream.FRandRange(-1500.f, 1500.f), Stream.FRandRange(-1500.f, 1500.f), 0.f);
+		if (FMath::Abs(Location.X - 500.f) > 150.f && Location.Size2D() > 200.f)
+		{
+			const EComponentMobility::Type Mobility = Targets.Num() % 2 ? EComponentMobility::Movable : EComponentMobility::Static;
+			Targets.Add(SpawnCube(World, Cube, Location, FVector(0.5f), Mobility));
+		}
+	}
+
+	UVigilFilter_LOS* Filter = NewObject<UVigilFilter_LOS>(GetTransientPackage());
+	UVigilFilter_LOSAsync* AsyncFilter = NewObject<UVigilFilter_LOSAsync>(GetTransientPackage());
+	SetPropertyValue(Filter, TEXT("LocationSource"), EVigilTargetLocationSource::Actor);
+	SetPropertyValue(AsyncFilter, TEXT("LocationSource"), EVigilTargetLocationSource::Actor);
+
+	// Trace each target synchronously
+	TArray<const AActor*> ExpectedTargets;
+	const FTargetingRequestHandle Handle = MakeRequest(SourceActor, Targets);
+	for (const FTargetingDefaultResultData& Result : FTargetingDefaultResultsSet::FindOrAdd(Handle).TargetResults)
+	{
+		if (!Filter->ShouldFilterTarget(Handle, Result))
+		{
+			ExpectedTargets.Add(Result.HitResult.GetActor());
+		}
+	}
+	UTargetingSubsystem::ReleaseTargetRequestHandle(Handle);
+
+	// Trace every target at once, async traces complete on a later world tick
+	const FTargetingRequestHandle AsyncHandle = MakeRequest(SourceActor, Targets);
+	FTargetingAsyncTaskData::FindOrAdd(AsyncHandle).bAsyncRequest = true;
+	static_cast<const UTargetingTask*>(AsyncFilter)->Execute(AsyncHandle);
+	for (int32 TickIndex = 0; TickIndex < 10 && IsAsyncFilterPending(AsyncHandle, AsyncFilter); ++TickIndex)
+	{
+		World->Tick(LEVELTICK_All, 0.01f);
+	}
+
+	const bool bCompleted = TestFalse(TEXT("Every async trace completed"), IsAsyncFilterPending(AsyncHandle, AsyncFilter));
+
+	TArray<const AActor*> AsyncTargets;
+	for (const FTargetingDefaultResultData& Result : FTargetingDefaultResultsSet::FindOrAdd(AsyncHandle).TargetResults)
+	{
+		AsyncTargets.Add(Result.HitResult.GetActor());
+	}
+	UTargetingSubsystem::ReleaseTargetRequestHandle(AsyncHandle);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	if (!bCompleted)
+	{
+		return false;
+	}
+
+	TestTrue(TEXT("The wall hides some targets but not all of them"), ExpectedTargets.Num() > 0 && ExpectedTargets.Num() < Targets.Num());
+	TestTrue(TEXT("The async filter keeps the same targets, in the same order, as the synchronous filter"), AsyncTargets == ExpectedTargets);
+	return true;
+}
+
+#endif
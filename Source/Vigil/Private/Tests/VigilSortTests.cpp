@@ -0,0 +1,299 @@
+﻿// Copyright (c) Jared Taylor
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "VigilStatics.h"
+#include "Sorting/VigilSort_Angle.h"
+#include "Sorting/VigilSort_AverageAngleDistance.h"
+#include "Sorting/VigilSort_Distance.h"
+#include "Targeting/VigilTargetingTypes.h"
+#include "TargetingSystem/TargetingSubsystem.h"
+#include "Components/SphereComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "UObject/StrongObjectPtr.h"
+#include "UObject/Package.h"
+
+namespace VigilSortTests
+{
+	/** Targets for a test request, each with its own component so each has its own candidate key */
+	struct FTestTargets
+	{
+		TArray<TStrongObjectPtr<USphereComponent>> Components;
+		TArray<FVector> Locations;
+
+		void Add(const FVector& Location)
+		{
+			Components.Emplace(NewObject<USphereComponent>(GetTransientPackage()));
+			Locations.Add(Location);
+		}
+	};
+
+	static const FVector SourceLocation = FVector(100.f, -200.f, 50.f);
+	static constexpr float MaxAngle = 180.f;
+	static constexpr float MaxDistance = 5000.f;
+
+	/** @return A location Distance from the source, Angle degrees from its forward direction and rolled around it by Roll degrees */
+	static FVector MakeLocation(float Angle, float Roll, float Distance)
+	{
+		const float AngleRad = FMath::DegreesToRadians(Angle);
+		const float RollRad = FMath::DegreesToRadians(Roll);
+		const FVector Direction = FVector::ForwardVector * FMath::Cos(AngleRad) +
+			(FVector::RightVector * FMath::Cos(RollRad) + FVector::UpVector * FMath::Sin(RollRad)) * FMath::Sin(AngleRad);
+		return SourceLocation + Direction * Distance;
+	}
+
+	/** Make a request with the data UVigilTargetSelection would have given the targets, in the order given */
+	static FTargetingRequestHandle MakeRequest(const FTestTargets& Targets)
+	{
+		const FTargetingRequestHandle Handle = UTargetingSubsystem::MakeTargetRequestHandle(nullptr, FTargetingSourceContext());
+
+		FVigilTargetingRequestData& RequestData = FVigilTargetingRequestData::FindOrAdd(Handle);
+		RequestData.bValid = true;
+		RequestData.SourceLocation = SourceLocation;
+		RequestData.SourceRotation = FQuat::Identity;
+		RequestData.SourceDirection = FVector::ForwardVector;
+		RequestData.MaxAngle = MaxAngle;
+		RequestData.MaxDistance = MaxDistance;
+
+		FTargetingDefaultResultsSet& Results = FTargetingDefaultResultsSet::FindOrAdd(Handle);
+		for (int32 TargetIndex = 0; TargetIndex < Targets.Locations.Num(); ++TargetIndex)
+		{
+			FTargetingDefaultResultData& Result = Results.TargetResults.AddDefaulted_GetRef();
+			Result.HitResult.Component = Targets.Components[TargetIndex].Get();
+			Result.HitResult.Location = Targets.Locations[TargetIndex];
+			Result.HitResult.ImpactPoint = Targets.Locations[TargetIndex];
+			RequestData.WriteToHitResult(Result.HitResult);
+		}
+		return Handle;
+	}
+
+	/** Run the sort task on a new request for the targets, and write the order it sorted their components in */
+	static void RunSort(const UTargetingTask* Sort, const FTestTargets& Targets, TArray<const UPrimitiveComponent*>& OutOrder,
+		TArray<FHitResult>* OutHits = nullptr)
+	{
+		const FTargetingRequestHandle Handle = MakeRequest(Targets);
+		Sort->Execute(Handle);
+
+		OutOrder.Reset();
+		if (const FTargetingDefaultResultsSet* Results = FTargetingDefaultResultsSet::Find(Handle))
+		{
+			for (const FTargetingDefaultResultData& Result : Results->TargetResults)
+			{
+				OutOrder.Add(Result.HitResult.GetComponent());
+				if (OutHits)
+				{
+					OutHits->Add(Result.HitResult);
+				}
+			}
+		}
+		UTargetingSubsystem::ReleaseTargetRequestHandle(Handle);
+	}
+
+	static void SetBoolProperty(UObject* Object, const TCHAR* PropertyName, bool bValue)
+	{
+		if (const FBoolProperty* Property = FindFProperty<FBoolProperty>(Object->GetClass(), PropertyName))
+		{
+			Property->SetPropertyValue_InContainer(Object, bValue);
+		}
+	}
+
+	/** @return True if both orders are the same, otherwise adds an error for the first target that differs */
+	static bool TestSameOrder(FAutomationTestBase& Test, const TCHAR* What, const TArray<const UPrimitiveComponent*>& Order,
+		const TArray<const UPrimitiveComponent*>& ExpectedOrder)
+	{
+		if (!Test.TestEqual(FString::Printf(TEXT("%s: Number of targets"), What), Order.Num(), ExpectedOrder.Num()))
+		{
+			return false;
+		}
+		for (int32 Position = 0; Position < Order.Num(); ++Position)
+		{
+			if (Order[Position] != ExpectedOrder[Position])
+			{
+				Test.AddError(FString::Printf(TEXT("%s: Targets differ from position %d"), What, Position));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Set an int console variable until the end of the scope */
+	struct FScopedIntCVar
+	{
+		FScopedIntCVar(const TCHAR* Name, int32 Value)
+			: CVar(IConsoleManager::Get().FindConsoleVariable(Name))
+		{
+			if (CVar)
+			{
+				PreviousValue = CVar->GetInt();
+				CVar->Set(Value, ECVF_SetByCode);
+			}
+		}
+
+		~FScopedIntCVar()
+		{
+			if (CVar)
+			{
+				CVar->Set(PreviousValue, ECVF_SetByCode);
+			}
+		}
+
+		IConsoleVariable* CVar;
+		int32 PreviousValue = 0;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVigilSortCosineScoreOrderTest, "Vigil.Sort.CosineScoreOrder", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FVigilSortCosineScoreOrderTest::RunTest(const FString& Parameters)
+{
+	using namespace VigilSortTests;
+
+	// The cosine score and the precomputed angle must order targets the same as the Acos of the hit result
+	// Acos loses precision near 0 and 180 degrees, so targets closer than this are allowed either way round
+	static constexpr float AngleTolerance = 0.05f;
+
+	FTestTargets Targets;
+	for (const float Angle : { 0.f, 0.2f, 0.5f, 1.f, 179.f, 179.5f, 179.8f, 180.f })
+	{
+		Targets.Add(MakeLocation(Angle, 0.f, 1000.f));
+	}
+
+	FRandomStream Stream(9001);
+	while (Targets.Locations.Num() < 256)
+	{
+		Targets.Add(MakeLocation(Stream.FRandRange(0.f, 180.f), Stream.FRandRange(0.f, 360.f), Stream.FRandRange(100.f, MaxDistance)));
+	}
+
+	for (const bool bCosineScore : { false, true })
+	{
+		UVigilSort_Angle* Sort = NewObject<UVigilSort_Angle>(GetTransientPackage());
+		SetBoolProperty(Sort, TEXT("bCosineScore"), bCosineScore);
+
+		TArray<const UPrimitiveComponent*> Order;
+		TArray<FHitResult> Hits;
+		RunSort(Sort, Targets, Order, &Hits);
+		if (!TestEqual(TEXT("Every target is sorted"), Order.Num(), Targets.Locations.Num()))
+		{
+			return false;
+		}
+
+		// The current implementation, i.e. GetSafeNormal, Acos and RadiansToDegrees for each target
+		float LastAngle = 0.f;
+		for (int32 Position = 0; Position < Hits.Num(); ++Position)
+		{
+			float NormalizedAngle, HitMaxAngle;
+			const float Angle = UVigilStatics::GetAngleToVigilTarget(Hits[Position], NormalizedAngle, HitMaxAngle);
+			if (Position > 0 && Angle < LastAngle - AngleTolerance)
+			{
+				AddError(FString::Printf(TEXT("bCosineScore: %d Target at %d has angle %.4f after a target with angle %.4f"),
+					bCosineScore, Position, Angle, LastAngle));
+				return false;
+			}
+			LastAngle = FMath::Max(LastAngle, Angle);
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVigilSortTemporalCoherenceTest, "Vigil.Sort.TemporalCoherence", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FVigilSortTemporalCoherenceTest::RunTest(const FString& Parameters)
+{
+	using namespace VigilSortTests;
+
+	// Radix sort every set, it relies on the keys being in index order to order ties
+	FScopedIntCVar RadixThreshold(TEXT("p.Vigil.Sort.RadixThreshold"), 1);
+
+	// A handful of locations, so most targets tie with others
+	TArray<FVector> Locations;
+	for (int32 LocationIndex = 0; LocationIndex < 8; ++LocationIndex)
+	{
+		Locations.Add(MakeLocation(0.f, 0.f, 100.f + LocationIndex * 400.f));
+	}
+
+	FRandomStream Stream(42);
+	FTestTargets Targets;
+	for (int32 TargetIndex = 0; TargetIndex < 512; ++TargetIndex)
+	{
+		Targets.Add(Locations[Stream.RandRange(0, Locations.Num() - 1)]);
+	}
+
+	UVigilSort_Distance* CoherentSort = NewObject<UVigilSort_Distance>(GetTransientPackage());
+	SetBoolProperty(CoherentSort, TEXT("bTemporalCoherence"), true);
+	const UVigilSort_Distance* Sort = NewObject<UVigilSort_Distance>(GetTransientPackage());
+
+	TArray<const UPrimitiveComponent*> Order;
+	TArray<const UPrimitiveComponent*> ExpectedOrder;
+
+	// The first scan has no previous order
+	RunSort(CoherentSort, Targets, Order);
+	RunSort(Sort, Targets, ExpectedOrder);
+	if (!TestSameOrder(*this, TEXT("First scan"), Order, ExpectedOrder))
+	{
+		return false;
+	}
+
+	// Move a few targets, the insertion sort finishes
+	for (int32 TargetIndex = 0; TargetIndex < 4; ++TargetIndex)
+	{
+		Targets.Locations[Stream.RandRange(0, Targets.Locations.Num() - 1)] = Locations[Stream.RandRange(0, Locations.Num() - 1)];
+	}
+	RunSort(CoherentSort, Targets, Order);
+	RunSort(Sort, Targets, ExpectedOrder);
+	if (!TestSameOrder(*this, TEXT("Few targets moved"), Order, ExpectedOrder))
+	{
+		return false;
+	}
+
+	// Move every target, the insertion sort gives up and falls back to a full sort
+	for (FVector& Location : Targets.Locations)
+	{
+		Location = Locations[Stream.RandRange(0, Locations.Num() - 1)];
+	}
+	RunSort(CoherentSort, Targets, Order);
+	RunSort(Sort, Targets, ExpectedOrder);
+	return TestSameOrder(*this, TEXT("Every target moved"), Order, ExpectedOrder);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FVigilSortParallelScoringTest, "Vigil.Sort.ParallelScoring", EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FVigilSortParallelScoringTest::RunTest(const FString& Parameters)
+{
+	using namespace VigilSortTests;
+
+	FRandomStream Stream(512);
+	FTestTargets Targets;
+	for (int32 TargetIndex = 0; TargetIndex < 512; ++TargetIndex)
+	{
+		Targets.Add(MakeLocation(Stream.FRandRange(0.f, 180.f), Stream.FRandRange(0.f, 360.f), Stream.FRandRange(100.f, MaxDistance)));
+	}
+
+	// Some targets tie, the parallel path must still order them by index
+	for (int32 TargetIndex = 0; TargetIndex < 64; ++TargetIndex)
+	{
+		Targets.Locations[Stream.RandRange(0, Targets.Locations.Num() - 1)] = Targets.Locations[TargetIndex];
+	}
+
+	const UVigilSort_AverageAngleDistance* Sort = NewObject<UVigilSort_AverageAngleDistance>(GetTransientPackage());
+
+	TArray<const UPrimitiveComponent*> SerialOrder;
+	{
+		FScopedIntCVar ParallelThreshold(TEXT("p.Vigil.Sort.ParallelThreshold"), 0);
+		RunSort(Sort, Targets, SerialOrder);
+	}
+
+	TArray<const UPrimitiveComponent*> ParallelOrder;
+	{
+		FScopedIntCVar ParallelThreshold(TEXT("p.Vigil.Sort.ParallelThreshold"), 1);
+		RunSort(Sort, Targets, ParallelOrder);
+	}
+
+	return TestSameOrder(*this, TEXT("Parallel scoring"), ParallelOrder, SerialOrder);
+}
+
+#endif
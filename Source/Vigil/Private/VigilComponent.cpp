@@ -3,12 +3,19 @@
 
 #include "VigilComponent.h"
 
+#include "System/VigilScanDriver.h"
+#include "System/VigilScanScheduler.h"
 #include "TargetingSystem/TargetingSubsystem.h"
 #include "GameFramework/Controller.h"
+#include "GameFramework/PlayerController.h"
 #include "GameFramework/Pawn.h"
 #include "Engine/World.h"
 #include "Engine/GameInstance.h"
 
+#if WITH_VIGIL_SIGNIFICANCE_MANAGER
+#include "SignificanceManager.h"
+#endif
+
 #include UE_INLINE_GENERATED_CPP_BY_NAME(VigilComponent)
 
 
@@ -45,7 +52,204 @@ AActor* UVigilComponent::GetTargetingSource_Implementation() const
 
 TMap<FGameplayTag, UTargetingPreset*> UVigilComponent::GetTargetingPresets_Implementation() const
 {
-	return ObjectPtrDecay(DefaultTargetingPresets);
+	if (!bLowSignificance || LowSignificancePresets.Num() == 0)
+	{
+		return ObjectPtrDecay(DefaultTargetingPresets);
+	}
+
+	// Swap in the cheaper presets while we're insignificant
+	TMap<FGameplayTag, UTargetingPreset*> Presets = ObjectPtrDecay(DefaultTargetingPresets);
+	for (const auto& LowPreset : LowSignificancePresets)
+	{
+		if (!Presets.Contains(LowPreset.Key))
+		{
+			continue;
+		}
+
+		if (LowPreset.Value)
+		{
+			Presets.Add(LowPreset.Key, LowPreset.Value);
+		}
+		else
+		{
+			Presets.Remove(LowPreset.Key);
+		}
+	}
+	return Presets;
+}
+
+float UVigilComponent::GetMaxVigilPipelineScanRate_Implementation(const FGameplayTag& PipelineTag) const
+{
+	const FVigilPipelineSettings* Settings = PipelineTag.IsValid() ? PipelineSettings.Find(PipelineTag) : nullptr;
+	if (Settings && Settings->MaxScanRate >= 0.f)
+	{
+		return ApplyScanLOD(Settings->MaxScanRate);
+	}
+	return GetMaxVigilScanRate();
+}
+
+float UVigilComponent::ApplyScanLOD(float ScanRate) const
+{
+	if (ScanLOD.Mode == EVigilSignificanceMode::None)
+	{
+		return ScanRate;
+	}
+
+	// Never scan faster than requested, only slower
+	const float LODScanRate = FMath::Lerp(ScanLOD.LowSignificanceScanRate, ScanRate, Significance);
+	return FMath::Max(ScanRate, LODScanRate);
+}
+
+float UVigilComponent::CalculateVigilSignificance_Implementation() const
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::CalculateVigilSignificance);
+
+	if (ScanLOD.Mode == EVigilSignificanceMode::None || !IsValid(GetWorld()))
+	{
+		return 1.f;
+	}
+
+	if (ScanLOD.bAlwaysSignificantForLocalPlayer && Controller && Controller->IsLocalPlayerController())
+	{
+		return 1.f;
+	}
+
+	const AActor* Source = GetTargetingSource();
+	if (!Source)
+	{
+		return 1.f;
+	}
+
+	switch (ScanLOD.Mode)
+	{
+	case EVigilSignificanceMode::ViewerDistance:
+		{
+			// Distance to the nearest local viewer, or any player's viewpoint if there are none (dedicated server)
+			const FVector SourceLocation = Source->GetActorLocation();
+			float MinDistSq = TNumericLimits<float>::Max();
+			for (const bool bLocalOnly : { true, false })
+			{
+				for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+				{
+					const APlayerController* PC = It->Get();
+					if (!PC || PC == Controller || (bLocalOnly && !PC->IsLocalController()))
+					{
+						continue;
+					}
+
+					FVector ViewLocation;
+					FRotator ViewRotation;
+					PC->GetPlayerViewPoint(ViewLocation, ViewRotation);
+					MinDistSq = FMath::Min<float>(MinDistSq, FVector::DistSquared(SourceLocation, ViewLocation));
+				}
+
+				if (MinDistSq < TNumericLimits<float>::Max())
+				{
+					break;
+				}
+			}
+
+			if (MinDistSq == TNumericLimits<float>::Max())
+			{
+				// Nobody is watching
+				return 0.f;
+			}
+
+			const float Distance = FMath::Sqrt(MinDistSq);
+			const float Range = FMath::Max(ScanLOD.FarDistance - ScanLOD.NearDistance, UE_KINDA_SMALL_NUMBER);
+			return 1.f - FMath::Clamp((Distance - ScanLOD.NearDistance) / Range, 0.f, 1.f);
+		}
+	case EVigilSignificanceMode::OnScreen:
+		return Source->WasRecentlyRendered(ScanLOD.OnScreenTolerance) ? 1.f : 0.f;
+	case EVigilSignificanceMode::SignificanceManager:
+#if WITH_VIGIL_SIGNIFICANCE_MANAGER
+		{
+			// Sources that aren't registered with the Significance Manager are not scaled
+			const USignificanceManager* SignificanceManager = USignificanceManager::Get(GetWorld());
+			if (!SignificanceManager || !SignificanceManager->GetManagedObject(const_cast<AActor*>(Source)))
+			{
+				return 1.f;
+			}
+			return FMath::Clamp(SignificanceManager->GetSignificance(Source) / ScanLOD.MaxSignificance, 0.f, 1.f);
+		}
+#else
+		// The Significance Manager plugin isn't enabled by this project, don't scale
+		return 1.f;
+#endif
+	default: return 1.f;
+	}
+}
+
+void UVigilComponent::UpdateVigilSignificance(bool bForce)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::UpdateVigilSignificance);
+
+	if (ScanLOD.Mode == EVigilSignificanceMode::None || !IsValid(GetWorld()))
+	{
+		return;
+	}
+
+	if (!bForce && LastSignificanceUpdateTime >= 0.f && GetWorld()->TimeSince(LastSignificanceUpdateTime) < ScanLOD.UpdateInterval)
+	{
+		return;
+	}
+
+	LastSignificanceUpdateTime = GetWorld()->GetTimeSeconds();
+	Significance = FMath::Clamp(CalculateVigilSignificance(), 0.f, 1.f);
+
+	// Swap to or from the cheaper presets
+	const bool bWasLowSignificance = bLowSignificance;
+	bLowSignificance = Significance < ScanLOD.LowSignificanceThreshold;
+	if (bLowSignificance != bWasLowSignificance && LowSignificancePresets.Num() > 0)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilComponent::UpdateVigilSignificance: %s low significance presets, Significance: %.2f"),
+			*GetRoleString(), bLowSignificance ? TEXT("Using") : TEXT("No longer using"), Significance);
+		UpdateTargetingPresets();
+	}
+}
+
+int32 UVigilComponent::GetVigilPipelinePriority_Implementation(const FGameplayTag& PipelineTag) const
+{
+	const FVigilPipelineSettings* Settings = PipelineTag.IsValid() ? PipelineSettings.Find(PipelineTag) : nullptr;
+	return Settings ? Settings->Priority : 0;
+}
+
+bool UVigilComponent::IsPipelineInFlight(const FGameplayTag& PipelineTag) const
+{
+	for (const auto& Request : TargetingRequests)
+	{
+		if (GetPipelineTag(Request.Key) == PipelineTag)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool UVigilComponent::ShouldSkipStationaryScan(const FGameplayTag& FocusTag, const FVector& SourceLocation,
+	const FQuat& SourceRotation)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::ShouldSkipStationaryScan);
+
+	if (!bSkipScansWhenSourceStationary || !IsValid(GetWorld()))
+	{
+		return false;
+	}
+
+	const float TimeSeconds = GetWorld()->GetTimeSeconds();
+	if (const FVigilScanSourcePose* LastPose = LastScanSourcePoses.Find(FocusTag))
+	{
+		const bool bRefreshDue = ForcedRefreshInterval > 0.f && TimeSeconds - LastPose->ScanTime >= ForcedRefreshInterval;
+		const bool bMoved = FVector::DistSquared(LastPose->Location, SourceLocation) > FMath::Square(StationaryLocationTolerance);
+		const bool bRotated = FMath::RadiansToDegrees(LastPose->Rotation.AngularDistance(SourceRotation)) > StationaryRotationTolerance;
+		if (!bRefreshDue && !bMoved && !bRotated)
+		{
+			return true;
+		}
+	}
+
+	LastScanSourcePoses.Add(FocusTag, { SourceLocation, SourceRotation, TimeSeconds });
+	return false;
 }
 
 void UVigilComponent::BeginPlay()
@@ -63,6 +267,62 @@ void UVigilComponent::BeginPlay()
 
 	// Bind the pawn changed event if required
 	UpdatePawnChangedBinding();
+
+	// Let the scheduler stagger and budget our scans
+	if (UVigilScanScheduler* Scheduler = UVigilScanScheduler::Get(GetWorld()))
+	{
+		Scheduler->RegisterComponent(this);
+	}
+
+	// Run without an ability, e.g. for AI controllers
+	if (bStartScanDriverOnBeginPlay)
+	{
+		StartScanDriver();
+	}
+}
+
+void UVigilComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopScanDriver();
+
+	if (UVigilScanScheduler* Scheduler = IsValid(GetWorld()) ? GetWorld()->GetSubsystem<UVigilScanScheduler>() : nullptr)
+	{
+		Scheduler->UnregisterComponent(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UVigilComponent::StartScanDriver()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::StartScanDriver);
+
+	if (IsValid(ScanDriver) && ScanDriver->IsScanning())
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilComponent::StartScanDriver: Already scanning"), *GetRoleString());
+		return;
+	}
+
+	if (!IsValid(ScanDriver) || ScanDriver->GetOuter() != this)
+	{
+		ScanDriver = NewObject<UVigilScanDriver>(this);
+	}
+
+	UE_LOG(LogVigil, Verbose, TEXT("%s VigilComponent::StartScanDriver"), *GetRoleString());
+	ScanDriver->StartScanning(this, ScanDriverSettings);
+}
+
+void UVigilComponent::StopScanDriver()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::StopScanDriver);
+
+	// The VigilScanTask stops its own driver
+	if (IsValid(ScanDriver) && ScanDriver->GetOuter() == this)
+	{
+		UE_LOG(LogVigil, Verbose, TEXT("%s VigilComponent::StopScanDriver"), *GetRoleString());
+		ScanDriver->StopScanning();
+		ScanDriver = nullptr;
+	}
 }
 
 void UVigilComponent::UpdatePawnChangedBinding()
@@ -89,6 +349,9 @@ void UVigilComponent::OnPawnChanged(APawn* OldPawn, APawn* NewPawn)
 {
 	TRACE_CPUPROFILER_EVENT_SCOPE(VigilComponent::OnPawnChanged);
 
+	// The source has changed, the next scan can't be skipped
+	InvalidateScanSourcePoses();
+
 	// Optionally end targeting requests
 	if (bEndTargetingRequestsOnPawnChange)
 	{
@@ -112,10 +375,17 @@ void UVigilComponent::UpdateTargetingPresets()
 	// Clear out any targeting presets that are no longer valid
 	for (const auto& Preset : LastTargetingPresets)
 	{
-		if (!CurrentTargetingPresets.Contains(Preset.Key))
+		const TObjectPtr<UTargetingPreset>* CurrentPreset = CurrentTargetingPresets.Find(Preset.Key);
+		if (!CurrentPreset)
 		{
+			LastScanSourcePoses.Remove(Preset.Key);
 			EndTargetingRequests(Preset.Key);
 		}
+		else if (*CurrentPreset != Preset.Value)
+		{
+			// The preset was swapped, e.g. for a low significance preset, its first scan can't be skipped
+			LastScanSourcePoses.Remove(Preset.Key);
+		}
 	}
 }
 
@@ -193,35 +463,41 @@ void UVigilComponent::EndTargetingRequests(const FGameplayTag& PresetTag, bool b
 
 	if (UTargetingSubsystem* TargetSubsystem = GetWorld()->GetGameInstance()->GetSubsystem<UTargetingSubsystem>())
 	{
-		// Oddly, there is no 'end all requests' option, and the handles are not accessible, so we track the handles ourselves
-		TArray<FGameplayTag> RemovedRequests;
-		for (auto& Request : TargetingRequests)
+		auto EndRequests = [TargetSubsystem, &PresetTag](TMap<FGameplayTag, FTargetingRequestHandle>& Requests)
 		{
-			// If no tag, remove them all
-			if (!PresetTag.IsValid() || Request.Key == PresetTag)
+			// Oddly, there is no 'end all requests' option, and the handles are not accessible, so we track the handles ourselves
+			TArray<FGameplayTag> RemovedRequests;
+			for (auto& Request : Requests)
 			{
-				RemovedRequests.Add(Request.Key);
-				TargetSubsystem->RemoveAsyncTargetingRequestWithHandle(Request.Value);
+				// If no tag, remove them all
+				if (!PresetTag.IsValid() || Request.Key == PresetTag)
+				{
+					RemovedRequests.Add(Request.Key);
+					TargetSubsystem->RemoveAsyncTargetingRequestWithHandle(Request.Value);
+				}
 			}
-		}
 
-		// If all requests were removed, clear the array
-		if (RemovedRequests.Num() == TargetingRequests.Num())
-		{
-			TargetingRequests.Empty();
-		}
-		else
-		{
-			for (auto& RemovedRequest : RemovedRequests)
+			// If all requests were removed, clear the array
+			if (RemovedRequests.Num() == Requests.Num())
 			{
-				TargetingRequests.Remove(RemovedRequest);
+				Requests.Empty();
 			}
-		}
+			else
+			{
+				for (auto& RemovedRequest : RemovedRequests)
+				{
+					Requests.Remove(RemovedRequest);
+				}
+			}
+		};
+
+		EndRequests(TargetingRequests);
+		EndRequests(PipelinedTargetingRequests);
 	}
 
 	// If we removed all requests, call the callback to tell Vigil to update itself
 	// It won't receive any callback if there is no pending request, so we need to trigger this
-	if (TargetingRequests.Num() == 0 && bNotifyVigil)
+	if (TargetingRequests.Num() == 0 && PipelinedTargetingRequests.Num() == 0 && bNotifyVigil)
 	{
 		(void)OnRequestVigil.ExecuteIfBound();
 	}
@@ -251,9 +251,23 @@ void UVigilStatics::VigilDrawDebugResults_Internal(AController* Controller, cons
 		const FString Tag = FocusResult.FocusTag.ToString();
 		const FString Score = FString::Printf(TEXT("P: %d Score:%.1f"), i, FocusResult.Score);
 
-		float NormalizedAngle, MaxAngle, NormalizedDistance, MaxDistance;
-		const float AngleValue = GetAngleToVigilTarget(FocusResult.HitResult, NormalizedAngle, MaxAngle);
-		const float DistanceValue = GetDistanceToVigilTarget(FocusResult.HitResult, NormalizedDistance, MaxDistance);
+		// Use the metrics computed during the targeting request if we have them
+		float NormalizedAngle, MaxAngle, NormalizedDistance, MaxDistance, AngleValue, DistanceValue;
+		if (FocusResult.Metrics.bValid && FocusResult.Metrics.bHasAngle)
+		{
+			const FVigilTargetMetrics& Metrics = FocusResult.Metrics;
+			AngleValue = Metrics.Angle;
+			NormalizedAngle = Metrics.NormalizedAngle;
+			MaxAngle = Metrics.MaxAngle;
+			DistanceValue = Metrics.Distance;
+			NormalizedDistance = Metrics.NormalizedDistance;
+			MaxDistance = Metrics.MaxDistance;
+		}
+		else
+		{
+			AngleValue = GetAngleToVigilTarget(FocusResult.HitResult, NormalizedAngle, MaxAngle);
+			DistanceValue = GetDistanceToVigilTarget(FocusResult.HitResult, NormalizedDistance, MaxDistance);
+		}
 
 		const FString Angle = FString::Printf(TEXT("A: %.1fº / %.1fº (%.1f%%)"), AngleValue, MaxAngle, NormalizedAngle);
 		const FString Distance = FString::Printf(TEXT("D: %.1f / %.1f (%.1f%%)"), DistanceValue, MaxDistance, NormalizedDistance);
@@ -56,6 +56,13 @@ FVector FVigilConeShape::GetConeBoxShapeHalfExtent() const
 	return HalfExtent;
 }
 
+float FVigilConeShape::GetTanHalfAngle(float Angle)
+{
+	// At 180 degrees anything in front of the cone's rear is within the angle
+	const float HalfAngle = 0.5f * Angle;
+	return HalfAngle < 90.f - UE_KINDA_SMALL_NUMBER ? FMath::Tan(FMath::DegreesToRadians(HalfAngle)) : UE_BIG_NUMBER;
+}
+
 FVigilConeShape FVigilConeShape::MakeConeFromScalableFloat(const FScalableFloat& Length,
 	const FScalableFloat& AngleWidth, const FScalableFloat& AngleHeight)
 {
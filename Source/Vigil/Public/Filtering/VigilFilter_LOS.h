@@ -68,6 +68,39 @@ protected:
 	 */
 	UPROPERTY(EditAnywhere, Category="Vigil Filter", meta=(UIMin="0", ClampMin="0", Delta="0.1", ForceUnits="cm"))
 	float TraceRadius = 0.f;
+
+	/**
+	 * Share line of sight verdicts with every other filter that traces the same way, across presets and controllers
+	 * Verdicts are reused for a short time unless the source or target moves, see UVigilLOSCache
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bUseLOSCache : 1 = false;
+
+	/**
+	 * Targets further than this are filtered without tracing
+	 * Use 0.0 to disable
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter", meta=(UIMin="0", ClampMin="0", ForceUnits="cm"))
+	float MaxTraceDistance = 0.f;
+
+	/**
+	 * Static actors with this tag are known occluders, targets behind their bounds are filtered without tracing
+	 * Occluders should be roughly box shaped, e.g. walls, as their entire bounds are considered solid
+	 * Use None to disable
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	FName OccluderTag = NAME_None;
+
+	/**
+	 * On clients, targets that were rendered within RecentlyRenderedTolerance pass without tracing
+	 * Rendering only means the camera can see the target, use with a ViewLocation source
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bPassRecentlyRendered : 1 = false;
+
+	/** How recently the target must have been rendered to pass without tracing */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter", meta=(EditCondition="bPassRecentlyRendered", UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float RecentlyRenderedTolerance = 0.1f;
 	
 public:
 	UVigilFilter_LOS(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
@@ -83,6 +116,50 @@ protected:
 	UFUNCTION(BlueprintNativeEvent, Category="Vigil Filter")
 	FVector GetSourceOffset(const FTargetingRequestHandle& TargetingHandle) const;
 
+	/**
+	 * Resolve our source location once per request instead of once per target
+	 * Cached in the request's FVigilTargetingRequestData
+	 */
+	FVector GetCachedSourceLocation(const FTargetingRequestHandle& TargetingHandle) const;
+
+	/**
+	 * Resolve the trace to a target
+	 * @return False if the target can't be traced, and should be filtered
+	 */
+	bool InitTrace(const FTargetingRequestHandle& TargetingHandle, const FTargetingDefaultResultData& TargetData,
+		FVector& OutTargetLocation, FCollisionQueryParams& OutParams, bool& bOutIgnoreMobility) const;
+
+	/** @return True if we don't have line of sight to the target based on the trace result, so it should be filtered */
+	static bool ShouldFilterTraceResult(const FHitResult& Hit, const AActor* TargetActor, bool bIgnoreMobility);
+
+	/** Draw the trace if p.Vigil.Filter.Debug is enabled */
+	void DebugDrawTrace(const UWorld* World, const FVector& SourceLocation, const FHitResult& Hit) const;
+
+	/**
+	 * Try to decide the target without tracing, using MaxTraceDistance, OccluderTag, bPassRecentlyRendered, and
+	 * the LOS cache
+	 * @return True if bOutFiltered is the verdict, false if the target must be traced
+	 */
+	bool PreFilterTarget(const UWorld* World, const FVector& SourceLocation, const FVector& TargetLocation,
+		const AActor* TargetActor, bool& bOutFiltered) const;
+
+	/** Record that a target was traced, see p.Vigil.Filter.LOSStats */
+	static void RecordTrace();
+
+	/** @return Hash of the settings that affect our trace, filters with the same hash share cached verdicts */
+	uint32 GetLOSCacheQueryHash() const;
+
+	/**
+	 * Find a cached verdict for the trace if bUseLOSCache is enabled
+	 * @return True if bOutFiltered can be used instead of tracing
+	 */
+	bool FindCachedVerdict(const UWorld* World, const FVector& SourceLocation, const FVector& TargetLocation,
+		const AActor* TargetActor, bool& bOutFiltered) const;
+
+	/** Cache the verdict for the trace if bUseLOSCache is enabled */
+	void CacheVerdict(const UWorld* World, const FVector& SourceLocation, const FVector& TargetLocation,
+		const AActor* TargetActor, bool bFiltered) const;
+
 	/** Setup CollisionQueryParams for the trace */
 	void InitCollisionParams(const FTargetingRequestHandle& TargetingHandle, FCollisionQueryParams& OutParams) const;
 };
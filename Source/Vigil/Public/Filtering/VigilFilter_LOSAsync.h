@@ -0,0 +1,39 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Filtering/VigilFilter_LOS.h"
+#include "WorldCollision.h"
+#include "VigilFilter_LOSAsync.generated.h"
+
+struct FVigilAsyncFilterState;
+
+/**
+ * Used to filter targets by line of sight, tracing every target at once with async traces
+ * The task stays executing until every trace completes, then removes the targets we have no line of sight to
+ * Immediate targeting requests trace synchronously, the same as UVigilFilter_LOS
+ */
+UCLASS(Blueprintable, DisplayName="Vigil Filter (LOS Async)")
+class VIGIL_API UVigilFilter_LOSAsync : public UVigilFilter_LOS
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Execute(const FTargetingRequestHandle& TargetingHandle) const override;
+
+protected:
+	/** Issue an async trace for every target */
+	void ExecuteAsyncTraces(const FTargetingRequestHandle& TargetingHandle) const;
+
+	/** Start an async trace using our channel, profile or object types */
+	void StartAsyncTrace(UWorld* World, const FVector& Start, const FVector& End, const FCollisionQueryParams& Params,
+		const FTraceDelegate& Delegate, uint32 UserData) const;
+
+	/** Callback for each async trace, filters the targets once every trace has completed */
+	void HandleAsyncTraceComplete(const FTraceHandle& InTraceHandle, FTraceDatum& InTraceDatum,
+		FTargetingRequestHandle TargetingHandle) const;
+
+	/** Remove every target we have no line of sight to */
+	void ApplyFilterResults(const FTargetingRequestHandle& TargetingHandle, const FVigilAsyncFilterState& State) const;
+};
@@ -0,0 +1,80 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tasks/TargetingFilterTask_BasicFilterTemplate.h"
+#include "VigilFilter_PawnRelationship.generated.h"
+
+class APawn;
+
+/**
+ * Used to filter targets by their team relationship to the source pawn, e.g. to find team mates or ignore them
+ * Native replacement for the VigilFilter_PawnRelationship Blueprint, the defaults filter nothing, same as the Blueprint
+ *
+ * Teams come from IGenericTeamAgentInterface on the pawn or its controller, and are looked up once per pawn per
+ * request, every target is then filtered in a single pass
+ * Override ShouldIgnorePawn for anything else
+ *
+ * Large target sets are filtered in parallel once their teams are resolved, see p.Vigil.Filter.ParallelThreshold
+ */
+UCLASS(Blueprintable, DisplayName="Vigil Filter (Pawn Relationship)")
+class VIGIL_API UVigilFilter_PawnRelationship : public UTargetingFilterTask_BasicFilterTemplate
+{
+	GENERATED_BODY()
+
+protected:
+	/** Filter pawns the source is friendly towards */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bFilterFriendly : 1 = false;
+
+	/** Filter pawns the source is neutral towards */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bFilterNeutral : 1 = false;
+
+	/** Filter pawns the source is hostile towards */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bFilterHostile : 1 = false;
+
+	/** Filter targets that are not pawns */
+	UPROPERTY(EditAnywhere, Category="Vigil Filter")
+	uint8 bFilterNonPawns : 1 = false;
+
+public:
+	/** Filters every target in a single pass, rather than once per target */
+	virtual void Execute(const FTargetingRequestHandle& TargetingHandle) const override;
+
+	virtual bool ShouldFilterTarget(const FTargetingRequestHandle& TargetingHandle, const FTargetingDefaultResultData& TargetData) const override;
+
+	/**
+	 * Native subclasses override to return true if their ShouldIgnorePawn_Implementation is safe to call from worker threads
+	 * Teams are resolved on the game thread first, so only the attitude solver and ShouldIgnorePawn run in parallel
+	 * This class and its Blueprint subclasses already filter in parallel, unless a Blueprint overrides ShouldIgnorePawn
+	 */
+	virtual bool CanFilterInParallel() const { return false; }
+
+protected:
+	/** @return True if the target pawn should be filtered */
+	UFUNCTION(BlueprintNativeEvent, Category="Vigil Filter")
+	bool ShouldIgnorePawn(const APawn* SourcePawn, const APawn* TargetPawn) const;
+
+	/** @return The pawn the request sources from, either the source actor or the pawn it controls */
+	static APawn* GetSourcePawn(const FTargetingRequestHandle& TargetingHandle);
+
+	/** @return The pawn's generic team ID, cached for the rest of the request */
+	static uint8 GetCachedTeamId(const FTargetingRequestHandle& TargetingHandle, const APawn* Pawn);
+
+	/** @return True if the source's attitude towards the team should be filtered */
+	bool ShouldFilterAttitude(uint8 SourceTeamId, uint8 TargetTeamId) const;
+
+	/** @return True if there are enough targets to filter in parallel, and it is safe to */
+	bool ShouldFilterInParallel(int32 NumTargets) const;
+
+	/** Resolve every target's team on the game thread, then decide which targets to filter in parallel */
+	void FilterTargetsInParallel(const FTargetingRequestHandle& TargetingHandle, const APawn* SourcePawn,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<uint8>& OutFiltered) const;
+
+	/** @return True if the target should be filtered, SourceTeamId is INDEX_NONE until resolved */
+	bool ShouldFilterTargetInternal(const FTargetingRequestHandle& TargetingHandle, const APawn* SourcePawn,
+		const AActor* TargetActor, int32& SourceTeamId) const;
+};
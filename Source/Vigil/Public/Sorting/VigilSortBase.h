@@ -4,8 +4,11 @@
 
 #include "CoreMinimal.h"
 #include "Tasks/TargetingTask.h"
+#include "UObject/ObjectKey.h"
 #include "VigilSortBase.generated.h"
 
+struct FVigilSortKeys;
+
 /**
  * Used to sort the available targets based on our criteria
  */
@@ -19,13 +22,61 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
 	uint8 bAscending : 1;
 
-	/** Should this task use a (slightly slower) sorting algorithm that preserves the relative ordering of targets with equal scores? */
+	/**
+	 * Should this task use a (slightly slower) sorting algorithm that preserves the relative ordering of targets with equal scores?
+	 * Targets are sorted by (score, index) keys, which always preserves their relative ordering, this no longer has any cost
+	 */
 	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
 	uint8 bStableSort : 1;
 
+	/**
+	 * Only keep the best this many targets, the rest are dropped before any later task or the VigilComponent sees them
+	 * The best targets are found with a partial selection instead of sorting every target
+	 * Generally only used by the preset's last sort task, as later sorts can't reconsider dropped targets
+	 * Use 0 to keep every target
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting", meta=(UIMin="0", ClampMin="0"))
+	int32 MaxResults = 0;
+
+	/**
+	 * Drop targets whose score is above PruneScore once this task has added its score
+	 * Put cheap sort tasks first with MaxResults or bPruneByScore, so expensive later tasks only score the survivors
+	 * e.g. a cosine angle sort pruning targets behind us before a screen distance sort or Blueprint scorer
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	uint8 bPruneByScore : 1 = false;
+
+	/**
+	 * Targets with a score above this are dropped, lower scores are better
+	 * Each task adds a score from 0 to 1 (or -1 to 0 if not ascending) to the scores of the tasks before it
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting", meta=(EditCondition="bPruneByScore"))
+	float PruneScore = 0.5f;
+
+	/**
+	 * Start from the order of the previous scan by the same source, then insertion sort
+	 * The order rarely changes between scans, so this is near linear
+	 * Falls back to a full sort when too much has changed, see p.Vigil.Sort.CoherenceMaxShifts
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	uint8 bTemporalCoherence : 1 = false;
+
+	/** Previous order of each source's targets, see bTemporalCoherence */
+	mutable TMap<FObjectKey, TArray<FObjectKey>> PreviousOrders;
+
 public:
 	UVigilSortBase(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
+	/** Score a single target, skips the reflection call unless a Blueprint overrides GetScoreForTarget */
+	float ScoreTarget(const FTargetingRequestHandle& TargetingHandle, const FTargetingDefaultResultData& TargetData) const;
+
+	/**
+	 * Score every target, used by AccumulateScores and when this task is evaluated as a criterion of UVigilSort_Composite
+	 * Skips the reflection call unless a Blueprint overrides GetScoresForTargets
+	 */
+	void GetRawScores(const FTargetingRequestHandle& TargetingHandle,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const;
+
 protected:
 	/** Called on every target to get a Score for sorting. This score will be added to the Score float in FTargetingDefaultResultData */
 	UFUNCTION(BlueprintNativeEvent, Category="Vigil Sorting")
@@ -34,6 +85,56 @@ protected:
 	virtual float GetScoreForTarget_Implementation(const FTargetingRequestHandle& TargetingHandle,
 		const FTargetingDefaultResultData& TargetData) const { return 0.f; }
 
+	/**
+	 * Called once with every target to get their Scores for sorting, OutScores must have a score for each target
+	 * Override in Blueprint to score every target in a single call instead of overriding GetScoreForTarget
+	 * Default implementation calls ScoreTargets, or GetScoreForTarget for each target
+	 */
+	UFUNCTION(BlueprintNativeEvent, Category="Vigil Sorting")
+	void GetScoresForTargets(const FTargetingRequestHandle& TargetingHandle,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const;
+
+	virtual void GetScoresForTargets_Implementation(const FTargetingRequestHandle& TargetingHandle,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const;
+
+	/**
+	 * Score every target at once natively, called by the default GetScoresForTargets
+	 * Override to resolve anything shared by every target once per request instead of once per target
+	 * @return False to score each target with GetScoreForTarget instead
+	 */
+	virtual bool ScoreTargets(const FTargetingRequestHandle& TargetingHandle,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const { return false; }
+
+	/** @return True if a Blueprint overrides GetScoreForTarget, which a native ScoreTargets must not bypass */
+	bool IsScoreForTargetImplementedInScript() const;
+
+	/**
+	 * Override to return true if GetScoreForTarget_Implementation is safe to call from worker threads
+	 * It must only read the target and Vigil's metrics, and can't touch the world, components or data stores
+	 * Ignored when a Blueprint overrides GetScoreForTarget, see p.Vigil.Sort.ParallelThreshold
+	 */
+	virtual bool CanScoreInParallel() const { return false; }
+
+	/** Called on the game thread before scoring in parallel, resolves anything the workers would otherwise write */
+	virtual void PrepareParallelScoring(const FTargetingRequestHandle& TargetingHandle) const;
+
+	/**
+	 * Add this task's normalized score to each target's Score, called before the targets are sorted
+	 * Default implementation calls GetRawScores and normalizes by the highest score
+	 */
+	virtual void AccumulateScores(const FTargetingRequestHandle& TargetingHandle, TArray<FTargetingDefaultResultData>& TargetResults) const;
+
+	/**
+	 * Seed the keys with the previous order of the same targets, new targets last, then insertion sort them
+	 * @return False if the keys are too far from sorted and need a full sort
+	 */
+	bool SortFromPreviousOrder(const TArray<FObjectKey>& PreviousOrder,
+		const TArray<FTargetingDefaultResultData>& TargetResults, FVigilSortKeys& Keys) const;
+
+	/** Remember the order of the targets for the next scan by the same source */
+	void StorePreviousOrder(const FObjectKey& SourceKey, const TArray<int32>& Order,
+		const TArray<FTargetingDefaultResultData>& TargetResults) const;
+
 	/** Evaluation function called by derived classes to process the targeting request */
 	virtual void Execute(const FTargetingRequestHandle& TargetingHandle) const override;
 
@@ -0,0 +1,68 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Compact (score, index) keys used by UVigilSortBase to sort targets without moving the results themselves
+ * Each key packs an order preserving transform of the score above the target's index, so keys are unique and every
+ * sort is stable, the results are then permuted once
+ *
+ * Large sets are radix sorted, see p.Vigil.Sort.RadixThreshold and p.Vigil.Sort.Benchmark
+ */
+struct VIGIL_API FVigilSortKeys
+{
+	TArray<uint64> Keys;
+
+	int32 Num() const { return Keys.Num(); }
+
+	void Reset(int32 ExpectedNum) { Keys.Reset(ExpectedNum); }
+
+	/** Add a target's score, add targets in index order so targets with equal scores keep their order */
+	void Add(float Score, int32 Index)
+	{
+		Keys.Add(static_cast<uint64>(ToSortableBits(Score)) << 32 | static_cast<uint32>(Index));
+	}
+
+	/**
+	 * Sort by ascending score, radix sorting if there are at least p.Vigil.Sort.RadixThreshold keys
+	 * The keys must be in index order, i.e. as added
+	 */
+	void Sort();
+
+	/** Sort by ascending score with a comparison sort */
+	void ComparisonSort();
+
+	/** Sort by ascending score with a radix sort, ties keep their current order so the keys must be in index order */
+	void RadixSort();
+
+	/**
+	 * Sort by ascending score with an insertion sort, near linear when the keys are already nearly sorted
+	 * @param MaxShifts Give up once this many keys have been shifted
+	 * @return False if we gave up, the keys are then only partially sorted
+	 */
+	bool InsertionSort(int32 MaxShifts);
+
+	/**
+	 * Keep only the lowest scores, sorted, without sorting the rest
+	 * Uses a heap so only the kept keys pay for sorting
+	 */
+	void SelectFirst(int32 NumToKeep);
+
+	/** @return The index of the target at this position once sorted */
+	int32 GetIndex(int32 Position) const { return static_cast<int32>(Keys[Position] & 0xFFFFFFFF); }
+
+	/** Write the sorted target indices */
+	void GetOrder(TArray<int32>& OutOrder) const;
+
+	/** @return Bits that sort in the same order as the float, negative scores included */
+	static uint32 ToSortableBits(float Score)
+	{
+		// Treat -0 as 0 so they aren't ordered differently
+		const float Value = Score == 0.f ? 0.f : Score;
+		uint32 Bits;
+		FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+		return (Bits & 0x80000000) ? ~Bits : Bits | 0x80000000;
+	}
+};
@@ -15,6 +15,16 @@ class VIGIL_API UVigilSort_Angle : public UVigilSortBase
 	GENERATED_BODY()
 
 protected:
+	/**
+	 * Score by 1 - cos(angle) instead of the angle, which skips the Acos
+	 * Orders targets the same, but the score is no longer linear in the angle when combined with other sort tasks
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	uint8 bCosineScore : 1 = false;
+
+protected:
+	virtual bool CanScoreInParallel() const override { return true; }
+
 	/** Called on every target to get a Score for sorting. This score will be added to the Score float in FTargetingDefaultResultData */
 	virtual float GetScoreForTarget_Implementation(const FTargetingRequestHandle& TargetingHandle,
 		const FTargetingDefaultResultData& TargetData) const override;
@@ -15,6 +15,8 @@ class VIGIL_API UVigilSort_AverageAngleDistance : public UVigilSortBase
 	GENERATED_BODY()
 
 protected:
+	virtual bool CanScoreInParallel() const override { return true; }
+
 	/** Called on every target to get a Score for sorting. This score will be added to the Score float in FTargetingDefaultResultData */
 	virtual float GetScoreForTarget_Implementation(const FTargetingRequestHandle& TargetingHandle,
 		const FTargetingDefaultResultData& TargetData) const override;
@@ -0,0 +1,66 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Sorting/VigilSortBase.h"
+#include "Sorting/VigilSort_ScreenDistance.h"
+#include "VigilSort_Composite.generated.h"
+
+UENUM(BlueprintType)
+enum class EVigilSortCriterion : uint8
+{
+	Angle				UMETA(ToolTip="Angle difference from the source"),
+	Distance			UMETA(ToolTip="Distance from the source"),
+	ScreenDistance		UMETA(ToolTip="Distance from the center of the screen, LOCAL player only"),
+	Custom				UMETA(ToolTip="Score from another Vigil Sort task"),
+};
+
+/** A single weighted criterion evaluated by UVigilSort_Composite */
+USTRUCT(BlueprintType)
+struct VIGIL_API FVigilSortCriterion
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	EVigilSortCriterion Criterion = EVigilSortCriterion::Angle;
+
+	/** How much this criterion contributes to the score, relative to the other criteria */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting", meta=(UIMin="0", ClampMin="0", Delta="0.05"))
+	float Weight = 1.f;
+
+	/** Do we increment (ascending) or decrement the score to find the best option */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	bool bAscending = true;
+
+	/** Score by 1 - cos(angle) instead of the angle, which skips the Acos */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting", meta=(EditCondition="Criterion==EVigilSortCriterion::Angle", EditConditionHides))
+	bool bCosineScore = false;
+
+	/** What world location to project to screen space, from which we compare with the screen center */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting", meta=(EditCondition="Criterion==EVigilSortCriterion::ScreenDistance", EditConditionHides))
+	EVigilScreenDistanceLocationSource LocationSource = EVigilScreenDistanceLocationSource::HitComponent;
+
+	/** Sort task used to score targets, only its GetScoresForTargets or GetScoreForTarget is used, its sorting properties are ignored */
+	UPROPERTY(EditAnywhere, Instanced, Category="Vigil Sorting", meta=(EditCondition="Criterion==EVigilSortCriterion::Custom", EditConditionHides))
+	TObjectPtr<UVigilSortBase> Scorer = nullptr;
+};
+
+/**
+ * Used to sort the available targets based on several weighted criteria
+ * Evaluates every criterion in one pass over the targets and sorts once, replacing a stack of Vigil Sort tasks
+ */
+UCLASS(DisplayName="Vigil Sort (Composite)")
+class VIGIL_API UVigilSort_Composite : public UVigilSortBase
+{
+	GENERATED_BODY()
+
+protected:
+	/** Each criterion is normalized by its highest score, then weighted and added to the target's score */
+	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
+	TArray<FVigilSortCriterion> Criteria;
+
+protected:
+	virtual void AccumulateScores(const FTargetingRequestHandle& TargetingHandle,
+		TArray<FTargetingDefaultResultData>& TargetResults) const override;
+};
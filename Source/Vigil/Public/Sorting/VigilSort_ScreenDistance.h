@@ -6,6 +6,9 @@
 #include "Sorting/VigilSortBase.h"
 #include "VigilSort_ScreenDistance.generated.h"
 
+class APlayerController;
+struct FVigilScreenProjection;
+
 UENUM(BlueprintType)
 enum class EVigilScreenDistanceLocationSource : uint8
 {
@@ -17,12 +20,36 @@ enum class EVigilScreenDistanceLocationSource : uint8
 /**
  * Used to sort the available targets based on their distance from the center of the screen/viewport
  * LOCAL player only -- not available to dedicated servers or simulated proxies
+ * Projects with the request's own source player, so split-screen players sort by their own view
  */
 UCLASS(DisplayName="Vigil Sort (Screen Distance)")
 class VIGIL_API UVigilSort_ScreenDistance : public UVigilSortBase
 {
 	GENERATED_BODY()
 
+public:
+	/** @return The local player controller the request sources from, nullptr if there is none */
+	static APlayerController* GetSourcePlayerController(const FTargetingRequestHandle& TargetingHandle);
+
+	/**
+	 * Resolve the source player's view projection once per request, cached in the request's FVigilTargetingRequestData
+	 * Invalid on dedicated servers, or if the source isn't a local player
+	 */
+	static const FVigilScreenProjection& GetScreenProjection(const FTargetingRequestHandle& TargetingHandle);
+
+	/** @return The world location to project for the target */
+	static FVector GetTargetWorldLocation(const FTargetingDefaultResultData& TargetData,
+		EVigilScreenDistanceLocationSource LocationSource);
+
+	/** @return Distance in pixels from the screen center to the target, 0 if it can't be projected */
+	static float GetScreenDistanceToTarget(const FVigilScreenProjection& Projection,
+		const FTargetingDefaultResultData& TargetData, EVigilScreenDistanceLocationSource LocationSource);
+
+	/** Project every target with a single view projection, 0 for any that can't be projected */
+	static void GetScreenDistancesToTargets(const FVigilScreenProjection& Projection,
+		const TArray<FTargetingDefaultResultData>& TargetResults, EVigilScreenDistanceLocationSource LocationSource,
+		TArray<float>& OutDistances);
+
 protected:
 	/** What world location to project to screen space, from which we compare with the screen center */
 	UPROPERTY(EditAnywhere, Category="Vigil Sorting")
@@ -32,4 +59,7 @@ protected:
 	/** Called on every target to get a Score for sorting. This score will be added to the Score float in FTargetingDefaultResultData */
 	virtual float GetScoreForTarget_Implementation(const FTargetingRequestHandle& TargetingHandle,
 		const FTargetingDefaultResultData& TargetData) const override;
+
+	virtual bool ScoreTargets(const FTargetingRequestHandle& TargetingHandle,
+		const TArray<FTargetingDefaultResultData>& TargetResults, TArray<float>& OutScores) const override;
 };
@@ -25,6 +25,8 @@ protected:
 	float AngleWeight = 0.75f;
 	
 protected:
+	virtual bool CanScoreInParallel() const override { return true; }
+
 	/** Called on every target to get a Score for sorting. This score will be added to the Score float in FTargetingDefaultResultData */
 	virtual float GetScoreForTarget_Implementation(const FTargetingRequestHandle& TargetingHandle,
 		const FTargetingDefaultResultData& TargetData) const override;
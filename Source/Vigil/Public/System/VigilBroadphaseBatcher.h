@@ -0,0 +1,97 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Types/TargetingSystemTypes.h"
+#include "VigilBroadphaseBatcher.generated.h"
+
+class UVigilTargetSelection;
+struct FOverlapDatum;
+struct FTraceHandle;
+
+/** A selection request waiting for its shared overlap */
+struct VIGIL_API FVigilBroadphaseRequest
+{
+	FVigilBroadphaseRequest(const UVigilTargetSelection* InSelection = nullptr,
+		const FTargetingRequestHandle& InTargetingHandle = {}, const FVector& InCenter = FVector::ZeroVector,
+		const FQuat& InRotation = FQuat::Identity, float InRadius = 0.f)
+		: Selection(InSelection)
+		, TargetingHandle(InTargetingHandle)
+		, Center(InCenter)
+		, Rotation(InRotation)
+		, Radius(InRadius)
+	{}
+
+	/** The selection task, requests are only grouped with others that use the same task */
+	TWeakObjectPtr<const UVigilTargetSelection> Selection;
+
+	FTargetingRequestHandle TargetingHandle;
+
+	/** Center of the request's overlap shape */
+	FVector Center;
+
+	/** Rotation of the request's overlap shape */
+	FQuat Rotation;
+
+	/** Radius of a sphere that encloses the request's overlap shape */
+	float Radius;
+};
+
+/**
+ * Groups async UVigilTargetSelection requests that use the same selection task and have nearby sources
+ * Each group performs a single enlarged sphere overlap, then each member tests the shared candidates against its own
+ * shape, instead of every member performing its own overlap against a nearly identical volume
+ *
+ * Enable per selection with UVigilTargetSelection::bShareBroadphase
+ * Configure with p.Vigil.Broadphase.ClusterRadius and p.Vigil.Broadphase.MaxGroupSize
+ */
+UCLASS()
+class VIGIL_API UVigilBroadphaseBatcher : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+	/** Requests added since the last tick */
+	TArray<FVigilBroadphaseRequest> PendingRequests;
+
+	/** Number of overlaps performed during the last tick */
+	int32 NumQueriesLastFrame = 0;
+
+	/** Number of requests serviced during the last tick */
+	int32 NumRequestsLastFrame = 0;
+
+public:
+	/** @return The batcher for this world, or nullptr if batching is disabled */
+	static UVigilBroadphaseBatcher* Get(const UWorld* World);
+
+	/**
+	 * Add a request to be grouped with others on the next tick
+	 * The selection's HandleSharedOverlapComplete() is called once the overlap completes
+	 * @param Location Center of the request's overlap shape
+	 * @param Rotation Rotation of the request's overlap shape
+	 * @param Radius Radius of a sphere centered on Location that encloses the request's overlap shape
+	 */
+	void AddRequest(const UVigilTargetSelection* Selection, const FTargetingRequestHandle& TargetingHandle,
+		const FVector& Location, const FQuat& Rotation, float Radius);
+
+	int32 GetNumQueriesLastFrame() const { return NumQueriesLastFrame; }
+	int32 GetNumRequestsLastFrame() const { return NumRequestsLastFrame; }
+
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	/** Perform a single overlap for the group */
+	void StartGroupOverlap(const UVigilTargetSelection* Selection, TArray<FVigilBroadphaseRequest>&& Members);
+
+	/** Hand the shared candidates to each member */
+	void HandleGroupOverlapComplete(const FTraceHandle& InTraceHandle, FOverlapDatum& InOverlapDatum,
+		TArray<FVigilBroadphaseRequest> Members);
+
+	/** @return True if the request was not ended while waiting */
+	static bool IsRequestValid(const FVigilBroadphaseRequest& Request);
+};
@@ -0,0 +1,133 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "VigilLOSCache.generated.h"
+
+/** Identifies a cached line of sight verdict */
+struct VIGIL_API FVigilLOSCacheKey
+{
+	FVigilLOSCacheKey(uint32 InQueryHash = 0, const FIntVector& InSourceCell = FIntVector::ZeroValue,
+		const FObjectKey& InTarget = {})
+		: QueryHash(InQueryHash)
+		, SourceCell(InSourceCell)
+		, Target(InTarget)
+	{}
+
+	/** Hash of the trace settings, only filters that trace the same way share verdicts */
+	uint32 QueryHash;
+
+	/** Quantized source location, see p.Vigil.LOSCache.CellSize */
+	FIntVector SourceCell;
+
+	/** The target actor */
+	FObjectKey Target;
+
+	bool operator==(const FVigilLOSCacheKey& Other) const
+	{
+		return QueryHash == Other.QueryHash && SourceCell == Other.SourceCell && Target == Other.Target;
+	}
+
+	friend uint32 GetTypeHash(const FVigilLOSCacheKey& Key)
+	{
+		return HashCombine(HashCombine(Key.QueryHash, GetTypeHash(Key.SourceCell)), GetTypeHash(Key.Target));
+	}
+};
+
+/** A cached line of sight verdict */
+struct VIGIL_API FVigilLOSCacheEntry
+{
+	/** Where the trace started and ended, the verdict is invalid once either has moved too far */
+	FVector SourceLocation = FVector::ZeroVector;
+	FVector TargetLocation = FVector::ZeroVector;
+
+	/** World time the trace was performed */
+	double Time = 0.0;
+
+	/** True if we had no line of sight, i.e. the target was filtered */
+	bool bFiltered = false;
+};
+
+/**
+ * Caches line of sight verdicts so the same target isn't traced again by every scan, every preset, and every nearby
+ * controller. Verdicts are keyed on the trace settings, the quantized source location, and the target
+ *
+ * Verdicts are reused until they are older than p.Vigil.LOSCache.TTL, or the source or target has moved further than
+ * p.Vigil.LOSCache.MoveThreshold since the trace
+ * Expired verdicts are refreshed at most p.Vigil.LOSCache.TraceBudget times per frame, the rest keep using their
+ * expired verdict until a later frame has budget, so refreshes are spread across frames instead of all at once
+ *
+ * Enable per filter with UVigilFilter_LOS::bUseLOSCache
+ *
+ * Also keeps the bounds of static occluder actors for UVigilFilter_LOS::OccluderTag, gathered the first time each tag
+ * is used, call RefreshOccluders() if occluders are added or removed, e.g. by level streaming
+ */
+UCLASS()
+class VIGIL_API UVigilLOSCache : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+	TMap<FVigilLOSCacheKey, FVigilLOSCacheEntry> Entries;
+
+	/** Traces performed for the cache this frame, counted against p.Vigil.LOSCache.TraceBudget */
+	int32 NumTracesThisFrame = 0;
+
+	/** World time expired verdicts were last removed */
+	double LastPruneTime = 0.0;
+
+	/** Stats for the last frame */
+	int32 NumHitsLastFrame = 0;
+	int32 NumStaleHitsLastFrame = 0;
+	int32 NumTracesLastFrame = 0;
+
+	int32 NumHitsThisFrame = 0;
+	int32 NumStaleHitsThisFrame = 0;
+
+	/** Bounds of the static actors with each occluder tag */
+	TMap<FName, TArray<FBox>> Occluders;
+
+public:
+	/** @return The cache for this world, or nullptr if the cache is disabled */
+	static UVigilLOSCache* Get(const UWorld* World);
+
+	/** @return The key for a trace from SourceLocation to the target */
+	static FVigilLOSCacheKey MakeKey(uint32 QueryHash, const FVector& SourceLocation, const AActor* TargetActor);
+
+	/**
+	 * Find a verdict that can be used instead of tracing
+	 * If this returns false the caller must trace and add the verdict with AddVerdict()
+	 * @return True if bOutFiltered is a usable verdict
+	 */
+	bool FindVerdict(const FVigilLOSCacheKey& Key, const FVector& SourceLocation, const FVector& TargetLocation,
+		bool& bOutFiltered);
+
+	/** Add or replace the verdict for a trace */
+	void AddVerdict(const FVigilLOSCacheKey& Key, const FVector& SourceLocation, const FVector& TargetLocation,
+		bool bFiltered);
+
+	/**
+	 * @return True if the segment passes through the bounds of a static actor with the tag
+	 * Occluders that contain either end of the segment are ignored
+	 */
+	bool IsOccluded(FName OccluderTag, const FVector& SourceLocation, const FVector& TargetLocation);
+
+	/** @return Bounds of the static actors with the tag */
+	const TArray<FBox>& GetOccluders(FName OccluderTag);
+
+	/** Gather the occluders again the next time they are used */
+	void RefreshOccluders() { Occluders.Reset(); }
+
+	int32 GetNum() const { return Entries.Num(); }
+	int32 GetNumHitsLastFrame() const { return NumHitsLastFrame; }
+	int32 GetNumStaleHitsLastFrame() const { return NumStaleHitsLastFrame; }
+	int32 GetNumTracesLastFrame() const { return NumTracesLastFrame; }
+
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+};
@@ -0,0 +1,131 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VigilTypes.h"
+#include "UObject/Object.h"
+#include "Types/TargetingSystemTypes.h"
+#include "VigilScanDriver.generated.h"
+
+class UVigilComponent;
+class UVigilScanScheduler;
+class UTargetingPreset;
+
+/**
+ * Runs Vigil's scan loop for a VigilComponent, requesting targeting and broadcasting the results
+ * Used by UVigilScanTask, or directly by the VigilComponent when there is no ability system, e.g. on AI controllers
+ * @see UVigilComponent::bStartScanDriverOnBeginPlay
+ */
+UCLASS()
+class VIGIL_API UVigilScanDriver : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	FTimerHandle VigilWaitTimer;
+
+	UPROPERTY()
+	FTimerHandle FailsafeTimer;
+
+	/** Wait timers for each pipeline, used when there is no VigilScanScheduler */
+	UPROPERTY()
+	TMap<FGameplayTag, FTimerHandle> PipelineTimers;
+
+protected:
+	UPROPERTY()
+	TWeakObjectPtr<UVigilComponent> VC;
+
+	UPROPERTY()
+	FVigilScanDriverSettings Settings;
+
+	TOptional<FString> WaitReason;
+	TOptional<FString> VeryVerboseWaitReason;
+
+	/** True between StartScanning and StopScanning */
+	bool bScanning = false;
+
+public:
+	virtual UWorld* GetWorld() const override;
+
+	/**
+	 * Bind to the VigilComponent and request the first scan
+	 * Scans continue until StopScanning is called or the VigilComponent is destroyed
+	 */
+	void StartScanning(UVigilComponent* InVigilComponent, const FVigilScanDriverSettings& InSettings);
+
+	/** Cancel any waits and unbind from the VigilComponent, in-progress targeting requests are left to complete */
+	void StopScanning();
+
+	bool IsScanning() const { return bScanning; }
+
+	UVigilComponent* GetVigilComponent() const { return VC.Get(); }
+
+	/**
+	 * Request every pipeline immediately and synchronously, bypassing throttling
+	 * Called by UVigilScanTask once a net sync has completed so the prediction window remains valid
+	 */
+	void RequestVigilSync();
+
+	/**
+	 * Wait before requesting the next Vigil
+	 * Uses the world's VigilScanScheduler when available so our requests are staggered and budgeted with every
+	 * other VigilComponent, otherwise falls back to a timer
+	 */
+	void WaitForVigil(float InDelay, const TOptional<FString>& Reason = {}, const TOptional<FString>& VeryVerboseReason = {});
+
+	/** Wait before requesting the next scan for a single pipeline, see UVigilComponent::GetPipelineTag() */
+	void WaitForVigilPipeline(const FGameplayTag& PipelineTag, float InDelay);
+
+	/** @return True if the pipeline is waiting on the scheduler or a timer to request its next scan */
+	bool IsPipelineWaiting(const FGameplayTag& PipelineTag) const;
+
+	/** Cancel the pending wait for a single pipeline */
+	void CancelVigilPipelineWait(const FGameplayTag& PipelineTag);
+
+	/** Cancel every pending wait, for the driver and all pipelines */
+	void CancelVigilWaits();
+
+	/** Request every pipeline that is not in flight or waiting */
+	void RequestVigil();
+	void OnVigilCompleteSync(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag, uint32 Sequence);
+	void OnVigilComplete(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag, uint32 Sequence);
+
+	/** Broadcast from VigilComponent */
+	void OnPauseVigil(bool bPaused);
+
+	/** Broadcast from VigilComponent after all our tasks were removed, i.e. we never get our callback to continue */
+	void OnRequestVigil();
+
+protected:
+	/** Delayed callback until we get the next targets */
+	EVigilNetSyncPendingState PendingNetSync = EVigilNetSyncPendingState::None;
+
+	/** True while RequestVigil is starting targeting requests, synchronous requests complete during this time */
+	bool bIssuingRequests = false;
+
+	/** World time each in-flight targeting request was started, used to detect hung requests */
+	TMap<FTargetingRequestHandle, float> RequestStartTimes;
+
+	/** Sequence number of the last request issued for each preset */
+	TMap<FGameplayTag, uint32> IssuedSequences;
+
+	/** Sequence number of the last request whose results were broadcast for each preset, older completions are stale */
+	TMap<FGameplayTag, uint32> CompletedSequences;
+
+	/** @return True if the pipeline can't accept another request until one completes */
+	bool IsPipelineSaturated(const FGameplayTag& PipelineTag) const;
+
+	/** @return True if the preset's scan can be skipped because its VigilTargetSelection source has not moved */
+	bool ShouldSkipStationaryScan(const FTargetingRequestHandle& TargetingHandle, const FGameplayTag& FocusTag,
+		const UTargetingPreset* Preset) const;
+
+	/** Start or restart the timer that ends hung targeting requests */
+	void SetFailsafeTimer();
+
+	/** @return The scheduler that issues our requests, or nullptr if we use our own timer */
+	UVigilScanScheduler* GetScheduler() const;
+
+	FString GetRoleString() const;
+};
@@ -0,0 +1,138 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "VigilTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "VigilScanScheduler.generated.h"
+
+class UVigilComponent;
+
+/**
+ * A scan that is waiting to be issued by the scheduler
+ * There is one per component and pipeline, see UVigilComponent::GetPipelineTag()
+ */
+struct VIGIL_API FVigilScheduledScan
+{
+	FVigilScheduledScan(UVigilComponent* InComponent = nullptr, const FGameplayTag& InPipelineTag = FGameplayTag::EmptyTag,
+		float InPhase = 0.f)
+		: Component(InComponent)
+		, ComponentKey(InComponent)
+		, PipelineTag(InPipelineTag)
+		, Phase(InPhase)
+	{}
+
+	/** The component that will be scanning */
+	TWeakObjectPtr<UVigilComponent> Component;
+
+	/** Key for the component, remains valid after the component is destroyed */
+	FObjectKey ComponentKey;
+
+	/** The pipeline being scanned, empty for the component as a whole */
+	FGameplayTag PipelineTag;
+
+	/** Called when the scheduler issues the scan */
+	FOnRequestVigil Callback;
+
+	/** World time at which the scan is due */
+	double DueTime = 0.0;
+
+	/** Higher priority scans are issued first when over budget */
+	int32 Priority = 0;
+
+	/** Normalized (0-1) offset used to stagger the first scan of this pipeline */
+	float Phase = 0.f;
+
+	/** True while a scan is waiting to be issued */
+	bool bScheduled = false;
+
+	/** True once the first scan has been staggered */
+	bool bStaggered = false;
+};
+
+/**
+ * Owns every registered VigilComponent in the world and issues their scans
+ * Scans are staggered so they don't all start on the same frame, and are issued only up to the per-frame budget
+ * Any scans over budget are deferred to the next frame, round-robin, so every component gets its turn
+ * Within a frame, due scans with a higher pipeline priority are issued first
+ *
+ * Budget is configured with p.Vigil.Scheduler.MaxScansPerFrame and p.Vigil.Scheduler.BudgetMs
+ */
+UCLASS()
+class VIGIL_API UVigilScanScheduler : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+protected:
+	typedef TPair<FObjectKey, FGameplayTag> FScanKey;
+
+	/** Components we own the scans of */
+	TMap<FObjectKey, TWeakObjectPtr<UVigilComponent>> Components;
+
+	/** All pending and idle scans, one per component pipeline */
+	TArray<FVigilScheduledScan> Scans;
+
+	/** Lookup from component and pipeline to index in Scans */
+	TMap<FScanKey, int32> ScanIndices;
+
+	/** Index in Scans to start from next frame, so deferred scans are served round-robin */
+	int32 RoundRobinIndex = 0;
+
+	/** Number of pipelines scheduled over the lifetime of the scheduler, used to distribute phases */
+	int32 NumRegistrations = 0;
+
+	/** Number of frames where issuing scans exceeded BudgetMs */
+	int32 NumBudgetOverruns = 0;
+
+	/** Number of scans deferred to a later frame during the last tick */
+	int32 NumDeferredLastFrame = 0;
+
+	/** Number of scans issued during the last tick */
+	int32 NumIssuedLastFrame = 0;
+
+public:
+	/** @return The scheduler for this world, or nullptr if scheduling is disabled */
+	static UVigilScanScheduler* Get(const UWorld* World);
+
+	/** Take ownership of scheduling for this component */
+	void RegisterComponent(UVigilComponent* Component);
+
+	/** Remove the component and drop all of its pending scans */
+	void UnregisterComponent(UVigilComponent* Component);
+
+	/**
+	 * Schedule a scan for the component's pipeline, replacing any scan already pending for that pipeline
+	 * The callback is executed once Delay has elapsed and there is budget left this frame
+	 * @param PipelineTag The pipeline to scan, empty for the component as a whole
+	 */
+	void ScheduleScan(UVigilComponent* Component, const FGameplayTag& PipelineTag, float Delay,
+		const FOnRequestVigil& Callback, int32 Priority = 0);
+
+	/** Cancel any pending scan for the component's pipeline */
+	void CancelScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag);
+
+	/** Cancel pending scans for all of the component's pipelines */
+	void CancelAllScans(const UVigilComponent* Component);
+
+	/** @return True if the component's pipeline has a scan waiting to be issued */
+	bool IsScanScheduled(const UVigilComponent* Component, const FGameplayTag& PipelineTag) const;
+
+	int32 GetNumRegisteredComponents() const { return Components.Num(); }
+	int32 GetNumBudgetOverruns() const { return NumBudgetOverruns; }
+	int32 GetNumDeferredLastFrame() const { return NumDeferredLastFrame; }
+	int32 GetNumIssuedLastFrame() const { return NumIssuedLastFrame; }
+
+public:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	FVigilScheduledScan* FindScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag);
+	const FVigilScheduledScan* FindScan(const UVigilComponent* Component, const FGameplayTag& PipelineTag) const;
+
+	/** Remove the scan at Index, keeping ScanIndices in sync */
+	void RemoveScanAt(int32 Index);
+};
@@ -0,0 +1,49 @@
+﻿// Copyright (c) Jared Taylor
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Structure-of-arrays buffer of candidate locations relative to a source, tested against a shape 4 at a time
+ * Used by UVigilTargetSelection to constrain box overlaps to the bounds of a cone or cylinder
+ */
+struct VIGIL_API FVigilCandidateBuffer
+{
+	/** Candidate locations relative to the source, padded to a multiple of 4 */
+	TArray<float> X;
+	TArray<float> Y;
+	TArray<float> Z;
+
+	/** Index of the overlap each candidate came from */
+	TArray<int32> SourceIndices;
+
+	/** 1 if the candidate passed the last test, 0 otherwise */
+	TArray<uint8> Inside;
+
+	int32 Num() const { return SourceIndices.Num(); }
+
+	void Reset(int32 ExpectedNum);
+
+	/** Add a candidate, RelativeLocation is relative to the origin of the shape it will be tested against */
+	void Add(const FVector& RelativeLocation, int32 SourceIndex);
+
+	/**
+	 * Test every candidate against a cone whose rear is at the origin
+	 * Angles are compared as tangent limits, so there is no Atan2 per candidate
+	 * @param TanHalfWidth Tan of half the cone's width angle, see FVigilConeShape::GetTanHalfAngle()
+	 * @param TanHalfHeight Tan of half the cone's height angle
+	 */
+	void TestCone(const FVector& Direction, const FVector& Right, const FVector& Up, float Length, float TanHalfWidth,
+		float TanHalfHeight);
+
+	/**
+	 * Test every candidate against an upright cylinder centered on the origin
+	 * @param bTestHeight If false only the radius is tested, e.g. when the overlap was already a box of the same height
+	 */
+	void TestCylinder(float Radius, float HalfHeight, bool bTestHeight);
+
+private:
+	/** Pad the buffers to a multiple of 4, padded candidates are never read */
+	int32 Pad();
+};
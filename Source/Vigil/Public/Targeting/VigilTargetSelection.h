@@ -8,6 +8,8 @@
 #include "Tasks/TargetingSelectionTask_AOE.h"
 #include "VigilTargetSelection.generated.h"
 
+struct FVigilCandidateBuffer;
+
 /**
  * Extend the shapes to include a cone
  * Adds location and rotation sources
@@ -53,6 +55,17 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="(RotationSource==EVigilTargetRotationSource::InputVector||RotationSource==EVigilTargetRotationSource::Velocity)&&(RotationSourceFallbackA==EVigilTargetRotationSource::InputVector||RotationSourceFallbackA==EVigilTargetRotationSource::Velocity)", EditConditionHides))
 	EVigilTargetRotationSource RotationSourceFallbackB;
 	
+	/** How the cone is overlapped before each candidate is tested against the cone itself */
+	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="ShapeType==EVigilTargetingShape::Cone", EditConditionHides))
+	EVigilConeBroadphase ConeBroadphase = EVigilConeBroadphase::Auto;
+
+	/**
+	 * Number of boxes to split the cone into for EVigilConeBroadphase::BoxChain
+	 * Each box is its own overlap query, more boxes fit the cone tighter, approaching a third of the volume of a single box
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="ShapeType==EVigilTargetingShape::Cone&&ConeBroadphase!=EVigilConeBroadphase::Box", EditConditionHides, UIMin="2", ClampMin="2", UIMax="8", ClampMax="8"))
+	int32 ConeChainSegments = 3;
+
 	/** What to check against for the cone's target */
 	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="ShapeType==EVigilTargetingShape::Cone", EditConditionHides))
 	EVigilConeTargetLocationSource ConeTargetSource;
@@ -73,10 +86,31 @@ protected:
 	/** If true can successfully overlap multiple components on the same actor */
 	UPROPERTY(EditAnywhere, Category="Vigil Selection")
 	bool bTraceMultipleComponentsPerActor;
+
+	/**
+	 * Which component to keep for each actor when bTraceMultipleComponentsPerActor is disabled
+	 * Actors are reduced before any filter or sort task runs, so each actor is only traced and scored once
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="!bTraceMultipleComponentsPerActor", EditConditionHides))
+	EVigilComponentReduction ComponentReduction = EVigilComponentReduction::First;
+
+	/** Components with this tag are kept for EVigilComponentReduction::FocusComponent */
+	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="!bTraceMultipleComponentsPerActor&&ComponentReduction==EVigilComponentReduction::FocusComponent", EditConditionHides))
+	FName FocusComponentTag = TEXT("VigilFocus");
 	
 	/** When enabled, the trace will be performed against complex collision. */
 	UPROPERTY(EditAnywhere, Category="Vigil Selection")
 	uint8 bTraceComplex : 1 = false;
+
+	/**
+	 * If true, async requests from nearby sources using this selection are grouped by UVigilBroadphaseBatcher into
+	 * a single enlarged overlap, then each request tests the shared candidates against its own shape
+	 * Use when many controllers scan the same area, e.g. AI squads or split-screen
+	 * Shared requests wait for the batcher's next tick, which can add up to a frame of latency to the scan
+	 * Cone and Cylinder only
+	 */
+	UPROPERTY(EditAnywhere, Category="Vigil Selection", meta=(EditCondition="ShapeType==EVigilTargetingShape::Cone||ShapeType==EVigilTargetingShape::Cylinder"))
+	bool bShareBroadphase = false;
 	
 protected:
 	/** Indicates the trace should ignore the source actor */
@@ -146,9 +180,43 @@ protected:
 	FQuat GetSourceRotationOffset(const FTargetingRequestHandle& TargetingHandle) const;
 
 public:
+	/**
+	 * Get the location and rotation the AOE is performed from, including offsets
+	 * Used by VigilScanDriver to skip scans when the source has not moved
+	 */
+	void GetSourcePose(const FTargetingRequestHandle& TargetingHandle, FVector& OutLocation, FQuat& OutRotation) const;
+
 	/** Evaluation function called by derived classes to process the targeting request */
 	virtual void Execute(const FTargetingRequestHandle& TargetingHandle) const override;
 
+	/**
+	 * Compute the source pose and evaluate our shape, stored in FVigilTargetingRequestData for every Vigil task in the request
+	 * Called once when the task executes
+	 */
+	const FVigilTargetingRequestData& InitRequestData(const FTargetingRequestHandle& TargetingHandle) const;
+
+	/** @return The request's FVigilTargetingRequestData, initializing it if we haven't executed yet */
+	const FVigilTargetingRequestData& GetRequestData(const FTargetingRequestHandle& TargetingHandle) const;
+
+	/** @return True if async requests can be grouped by UVigilBroadphaseBatcher */
+	bool CanShareBroadphase() const
+	{
+		return bShareBroadphase && (ShapeType == EVigilTargetingShape::Cone || ShapeType == EVigilTargetingShape::Cylinder);
+	}
+
+	bool IsTraceComplex() const { return bTraceComplex; }
+
+	/** Start an async overlap using this selection's collision settings */
+	void StartAsyncOverlap(UWorld* World, const FVector& Location, const FQuat& Rotation, const FCollisionShape& CollisionShape,
+		const FCollisionQueryParams& Params, const FOverlapDelegate& Delegate) const;
+
+	/** Start the async overlap for this request alone, using our own shape */
+	void StartOwnAsyncOverlap(UWorld* World, const FTargetingRequestHandle& TargetingHandle, const FVector& Location,
+		const FQuat& Rotation) const;
+
+	/** Called by UVigilBroadphaseBatcher with the candidates of the shared overlap this request was grouped into */
+	void HandleSharedOverlapComplete(const FTargetingRequestHandle& TargetingHandle, const TArray<FOverlapResult>& Overlaps) const;
+
 protected:
 	/** Method to process the trace task immediately */
 	void ExecuteImmediateTrace(const FTargetingRequestHandle& TargetingHandle) const;
@@ -160,15 +228,67 @@ protected:
 	void HandleAsyncOverlapComplete(const FTraceHandle& InTraceHandle, FOverlapDatum& InOverlapDatum,
 		FTargetingRequestHandle TargetingHandle) const;
 
+	/** Callback for each async overlap of a cone's box chain, processes the results once every box has completed */
+	void HandleAsyncChainOverlapComplete(const FTraceHandle& InTraceHandle, FOverlapDatum& InOverlapDatum,
+		FTargetingRequestHandle TargetingHandle) const;
+
+	/**
+	 * Start async traces for EVigilConeTargetLocationSource::TraceMesh so the overlap callback doesn't block on them
+	 * @return True if traces were started, the task then completes in HandleAsyncTraceMeshComplete
+	 */
+	bool StartAsyncTraceMesh(const FTargetingRequestHandle& TargetingHandle, const TArray<FOverlapResult>& Overlaps,
+		bool bSharedBroadphase) const;
+
+	/** Callback for each async TraceMesh trace, processes the overlaps once every trace has completed */
+	void HandleAsyncTraceMeshComplete(const FTraceHandle& InTraceHandle, FTraceDatum& InTraceDatum,
+		FTargetingRequestHandle TargetingHandle) const;
+
+	/** @return True if the cone should be overlapped with a chain of boxes instead of a single box */
+	bool ShouldUseConeBoxChain(const FVigilTargetingRequestData& RequestData) const;
+
+	/**
+	 * Build the chain of boxes that bounds the cone, stored in FVigilTargetingRequestData::ConeBroadphaseBoxes
+	 * @param MinForward Distance from the cone's rear where the chain starts, anything before it is not overlapped
+	 */
+	void BuildConeBoxChain(FVigilTargetingRequestData& RequestData, float MinForward) const;
+
+	/** Overlap immediately using this selection's collision settings, appending to OutOverlaps */
+	void OverlapMulti(const UWorld* World, const FVector& Location, const FQuat& Rotation, const FCollisionShape& CollisionShape,
+		const FCollisionQueryParams& Params, TArray<FOverlapResult>& OutOverlaps) const;
+
+	/** Remove overlaps of the same component, which happens when the overlapped boxes intersect */
+	static void RemoveDuplicateOverlaps(TArray<FOverlapResult>& Overlaps);
+
+	/**
+	 * Choose a single candidate for each actor using ComponentReduction
+	 * Actors that already have a result are skipped, using a set rather than searching the results for each candidate
+	 * @param bTestedCandidates If true, candidates that failed the shape test are skipped
+	 * @param OutActorCandidates The candidate index to keep for each actor
+	 */
+	void ReduceComponentsPerActor(const FVigilTargetingRequestData& RequestData,
+		const TArray<FTargetingDefaultResultData>& ExistingResults, const TArray<FOverlapResult>& Overlaps,
+		const FVigilCandidateBuffer& Candidates, const FVector& ShapeOrigin, bool bTestedCandidates,
+		TMap<const AActor*, int32>& OutActorCandidates) const;
+
+	/** Record the cone's broadphase candidates and accepted results, see p.Vigil.Selection.BroadphaseStats */
+	void RecordConeBroadphaseStats(const FVigilTargetingRequestData& RequestData, int32 NumCandidates, int32 NumAccepted) const;
+
 	/**
 	 * Method to take the overlap results and store them in the targeting result data
+	 * @param bSharedBroadphase True if the overlaps came from a shared overlap, which was not bounded by our shape or
+	 *	collision params, so they are tested here instead
+	 * @param ConeTargetLocations Cone target location for each overlap if already resolved, e.g. by async TraceMesh traces
 	 * @return Num valid results
 	 */
-	int32 ProcessOverlapResults(const FTargetingRequestHandle& TargetingHandle, const TArray<FOverlapResult>& Overlaps) const;
+	int32 ProcessOverlapResults(const FTargetingRequestHandle& TargetingHandle, const TArray<FOverlapResult>& Overlaps,
+		bool bSharedBroadphase = false, const TArray<FVector>* ConeTargetLocations = nullptr) const;
 	
 protected:
 	/** Helper method to build the Collision Shape */
 	FCollisionShape GetCollisionShape() const;
+
+	/** Build the Collision Shape from the request's evaluated shape */
+	FCollisionShape GetCollisionShape(const FVigilTargetingRequestData& RequestData) const;
 	
 	/** Helper method to find the custom component defined on the source actor */
 	const UPrimitiveComponent* GetCollisionComponent(const FTargetingRequestHandle& TargetingHandle) const;
@@ -38,6 +38,34 @@ public:
 	UFUNCTION(BlueprintCallable, Category=Vigil)
 	static FQuat GetSourceRotation(const FTargetingRequestHandle& TargetingHandle, EVigilTargetRotationSource RotationSource, bool& bZeroVector);
 
+	/**
+	 * Compute the distance to the target using the request's FVigilTargetingRequestData
+	 * Falls back to the values stored in the hit result by UVigilTargetSelection if the request has none
+	 * @param NormalizedDistance The normalized distance to the target (0.0 - 1.0)
+	 * @param MaxDistance The maximum distance to the target
+	 */
+	UFUNCTION(BlueprintCallable, Category=Vigil, meta=(DisplayName="Get Distance to Vigil Target (Request)"))
+	static float GetDistanceToVigilTarget(const FTargetingRequestHandle& TargetingHandle, const FHitResult& HitResult,
+		float& NormalizedDistance, float& MaxDistance);
+
+	/**
+	 * Compute the angle to the target using the request's FVigilTargetingRequestData
+	 * Falls back to the values stored in the hit result by UVigilTargetSelection if the request has none
+	 * @param NormalizedAngle The normalized angle to the target (0.0 - 1.0)
+	 * @param MaxAngle The maximum angle to the target
+	 */
+	UFUNCTION(BlueprintCallable, Category=Vigil, meta=(DisplayName="Get Angle to Vigil Target (Request)"))
+	static float GetAngleToVigilTarget(const FTargetingRequestHandle& TargetingHandle, const FHitResult& HitResult,
+		float& NormalizedAngle, float& MaxAngle);
+
+	/**
+	 * Get the target's metrics from the request's candidate metrics table, computed once and shared by every sort task
+	 * If the request has no FVigilTargetingRequestData the metrics are computed from the hit result and bValid is false
+	 * @param bNeedAngle False if only the distance and AngleCos are required, skips the Acos
+	 */
+	static FVigilTargetMetrics GetVigilTargetMetrics(const FTargetingRequestHandle& TargetingHandle,
+		const FTargetingDefaultResultData& TargetData, bool bNeedAngle = true);
+
 	/** Setup CollisionQueryParams for the AOE */
 	static void InitCollisionParams(const FTargetingRequestHandle& TargetingHandle, FCollisionQueryParams& OutParams,
 		bool bIgnoreSourceActor = true, bool bIgnoreInstigatorActor = false, bool bTraceComplex = false);
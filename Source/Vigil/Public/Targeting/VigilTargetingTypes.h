@@ -3,6 +3,11 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "VigilTypes.h"
+#include "Types/TargetingSystemTypes.h"
+#include "Types/TargetingSystemDataStores.h"
+#include "UObject/ObjectKey.h"
+#include "Engine/OverlapResult.h"
 #include "VigilTargetingTypes.generated.h"
 
 
@@ -43,9 +48,206 @@ enum class EVigilConeTargetLocationSource : uint8
 	TraceMesh				UMETA(ToolTip="Complex line trace towards the component if it exists, otherwise the actor, and use the impact point - EXPENSIVE!"),
 };
 
+UENUM(BlueprintType)
+enum class EVigilConeBroadphase : uint8
+{
+	Auto					UMETA(ToolTip="Use BoxChain for cones at least p.Vigil.Selection.ConeChainMinLength long, otherwise Box"),
+	Box						UMETA(ToolTip="Overlap a single box around the whole cone"),
+	BoxChain				UMETA(ToolTip="Overlap a chain of boxes along the cone's axis, each bounding its own slice of the cone, which returns fewer candidates for wide or long cones"),
+};
+
+UENUM(BlueprintType)
+enum class EVigilComponentReduction : uint8
+{
+	First					UMETA(ToolTip="Keep the first component found on each actor"),
+	Closest					UMETA(ToolTip="Keep the component closest to the source on each actor"),
+	BestAngle				UMETA(ToolTip="Keep the component with the smallest angle to the source direction on each actor"),
+	FocusComponent			UMETA(ToolTip="Keep the component with the focus component tag on each actor, or the closest if none have it"),
+};
+
 UENUM(BlueprintType)
 enum class EVigilTargetLocationSource_LOS : uint8
 {
 	BoundsOrigin			UMETA(ToolTip="Use the origin of the actor's bounds"),
 	Actor					UMETA(ToolTip="Use the actor location"),
 };
+
+/** A box overlapped as part of a cone's broadphase, aligned to the source rotation */
+struct VIGIL_API FVigilBroadphaseBox
+{
+	FVigilBroadphaseBox(const FVector& InCenter, const FVector& InHalfExtent)
+		: Center(InCenter)
+		, HalfExtent(InHalfExtent)
+	{}
+
+	FVector Center;
+	FVector HalfExtent;
+};
+
+/** An async filter waiting on its traces, e.g. UVigilFilter_LOSAsync */
+struct VIGIL_API FVigilAsyncFilterState
+{
+	/** The target each trace was issued for, a result is only applied if its target is still at the same index */
+	TArray<FObjectKey> Targets;
+
+	/** 1 if the target should be filtered */
+	TArray<uint8> Filtered;
+
+	/** 1 if the target's trace ignores the target because of its mobility */
+	TArray<uint8> IgnoreMobility;
+
+	/** Where each target's trace ends, used to cache the verdict */
+	TArray<FVector> TargetLocations;
+
+	int32 NumPending = 0;
+};
+
+/** The source player's view projection, resolved once per request for screen space sorting */
+struct VIGIL_API FVigilScreenProjection
+{
+	FMatrix ViewProjectionMatrix = FMatrix::Identity;
+
+	/** The player's view within the viewport, only part of it when using split-screen */
+	FIntRect ViewRect;
+
+	/** True once we have tried to resolve the projection for the request */
+	bool bResolved = false;
+
+	/** True if the projection can be used, i.e. the source has a local player with a viewport */
+	bool bValid = false;
+
+	/** @return Center of the player's view, relative to the view */
+	FVector2D GetScreenCenter() const { return FVector2D(ViewRect.Width(), ViewRect.Height()) * 0.5; }
+
+	/**
+	 * Project a world location to the player's view, relative to the view
+	 * @return False if the location is behind the view
+	 */
+	bool Project(const FVector& WorldLocation, FVector2D& OutScreenLocation) const;
+};
+
+/**
+ * Per-request data computed once by UVigilTargetSelection and read by every Vigil task in the request
+ * Results also store these in their FHitResult for anything that only has the hit result, e.g. FVigilFocusResult
+ *	TraceStart: SourceLocation
+ *	Normal: SourceDirection
+ *	Time: MaxAngle
+ *	PenetrationDepth: MaxDistance
+ */
+struct VIGIL_API FVigilTargetingRequestData
+{
+	DECLARE_TARGETING_DATA_STORE(FVigilTargetingRequestData)
+
+	/** True once populated by UVigilTargetSelection */
+	bool bValid = false;
+
+	/** Location the selection is performed from, including offsets */
+	FVector SourceLocation = FVector::ZeroVector;
+
+	/** Rotation the selection is performed from, including offsets and fallbacks */
+	FQuat SourceRotation = FQuat::Identity;
+
+	/** SourceRotation's forward vector */
+	FVector SourceDirection = FVector::ForwardVector;
+
+	EVigilTargetingShape ShapeType = EVigilTargetingShape::Cone;
+
+	/** Evaluated cone shape */
+	FVigilConeShape Cone;
+
+	/** Origin used for cone angle checks, the rear of the cone */
+	FVector ConeRear = FVector::ZeroVector;
+
+	/** Cone axes perpendicular to SourceDirection */
+	FVector ConeRight = FVector::RightVector;
+	FVector ConeUp = FVector::UpVector;
+
+	/** Tan of the cone's half angles, see FVigilConeShape::GetTanHalfAngle() */
+	float ConeTanHalfWidth = 0.f;
+	float ConeTanHalfHeight = 0.f;
+
+	/** Boxes overlapped when the cone uses EVigilConeBroadphase::BoxChain, empty for a single box */
+	TArray<FVigilBroadphaseBox> ConeBroadphaseBoxes;
+
+	/** Overlaps gathered from the broadphase boxes while we wait for the rest of their async overlaps */
+	TArray<FOverlapResult> PendingOverlaps;
+	int32 NumPendingOverlaps = 0;
+
+	/** Overlaps waiting on their async EVigilConeTargetLocationSource::TraceMesh traces */
+	TArray<FOverlapResult> TraceMeshOverlaps;
+
+	/** Target location for each of TraceMeshOverlaps, updated by each trace as it completes */
+	TArray<FVector> TraceMeshLocations;
+	int32 NumPendingTraceMeshTraces = 0;
+	bool bTraceMeshSharedBroadphase = false;
+
+	/** Evaluated shape extents */
+	FVector HalfExtent = FVector::ZeroVector;
+	float Radius = 0.f;
+	float HalfHeight = 0.f;
+
+	/** Largest angle a target can be from SourceDirection, used to normalize angle scores */
+	float MaxAngle = 0.f;
+
+	/** Largest distance a target can be from SourceLocation, used to normalize distance scores */
+	float MaxDistance = 0.f;
+
+	/** Source locations of other tasks in the request, each computed once, e.g. UVigilFilter_LOS */
+	TMap<FObjectKey, FVector> TaskSourceLocations;
+
+	/** Async filters waiting on their traces, keyed by the filter task */
+	TMap<FObjectKey, FVigilAsyncFilterState> AsyncFilterStates;
+
+	/** Generic team ID of each actor looked up during the request, e.g. UVigilFilter_PawnRelationship */
+	TMap<FObjectKey, uint8> TeamIds;
+
+	/** The source player's view projection, see UVigilSort_ScreenDistance::GetScreenProjection() */
+	FVigilScreenProjection ScreenProjection;
+
+	/** Targets pruned by sort tasks so far, later sort tasks skip evaluating them, see p.Vigil.Sort.CascadeStats */
+	int32 NumPrunedTargets = 0;
+
+	/**
+	 * Metrics for each target, index aligned with FTargetingDefaultResultsSet::TargetResults
+	 * Built on first use and realigned when filters or sorts change the results
+	 * @see GetCandidateMetrics()
+	 */
+	TArray<FVigilTargetMetrics> CandidateMetrics;
+
+	/** The target each entry in CandidateMetrics belongs to, used to detect when the results have changed */
+	TArray<FObjectKey> CandidateKeys;
+
+	/** Distance from SourceLocation to the target, NormalizedDistance is 0-1 of MaxDistance */
+	float GetDistanceToTarget(const FVector& TargetLocation, float& NormalizedDistance) const;
+
+	/** Angle in degrees from SourceDirection to the target, NormalizedAngle is 0-1 of MaxAngle */
+	float GetAngleToTarget(const FVector& TargetLocation, float& NormalizedAngle) const;
+
+	/** Store our data in the hit result fields listed above */
+	void WriteToHitResult(FHitResult& HitResult) const;
+
+	/** Compute the metrics for a target, the angle is left for EnsureAngle() unless bComputeAngle is true */
+	FVigilTargetMetrics ComputeMetrics(const FVector& TargetLocation, bool bComputeAngle = false) const;
+
+	/** Compute Angle and NormalizedAngle from AngleCos if we haven't already */
+	void EnsureAngle(FVigilTargetMetrics& Metrics) const;
+
+	/** @return The metrics for a target in TargetResults, or nullptr if it isn't part of them, e.g. a copy made by Blueprint */
+	FVigilTargetMetrics* GetCandidateMetrics(const TArray<FTargetingDefaultResultData>& TargetResults,
+		const FTargetingDefaultResultData& TargetData, bool bNeedAngle = true);
+
+	/** @return True if CandidateMetrics is index aligned with TargetResults */
+	bool IsAlignedWith(const TArray<FTargetingDefaultResultData>& TargetResults) const;
+
+	/** Realign CandidateMetrics with TargetResults, only computing metrics for targets we haven't seen */
+	void SyncCandidateMetrics(const TArray<FTargetingDefaultResultData>& TargetResults);
+
+	/**
+	 * Reorder CandidateMetrics after TargetResults were reordered, NewOrder[i] is the previous index of the target now at i
+	 * NewOrder can be shorter than CandidateMetrics if TargetResults were truncated, the rest are dropped
+	 */
+	void PermuteCandidateMetrics(const TArray<int32>& NewOrder);
+
+	/** The key CandidateKeys uses for a target */
+	static FObjectKey GetCandidateKey(const FTargetingDefaultResultData& TargetData);
+};
@@ -12,10 +12,12 @@
 #include "VigilComponent.generated.h"
 
 class AController;
+class UVigilScanDriver;
 
 /**
  * Add to your Controller
  * Interfaces with the passive VigilScanAbility and handles resulting data
+ * Controllers without an ability system, e.g. AI, can run Vigil with bStartScanDriverOnBeginPlay instead
  * Subclass this to add custom functionality
  */
 UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent))
@@ -47,6 +49,70 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil)
 	bool bEndTargetingRequestsOnPawnChange = false;
 
+	/**
+	 * If true, each targeting preset runs as its own pipeline with its own rate and in-flight request
+	 * Otherwise every preset is requested together and the next scan waits for all of them to complete
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil)
+	bool bIndependentPresetPipelines = true;
+
+	/** Per focus tag rate and priority, used when bIndependentPresetPipelines is enabled */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil, meta=(EditCondition="bIndependentPresetPipelines"))
+	TMap<FGameplayTag, FVigilPipelineSettings> PipelineSettings;
+
+	/**
+	 * Maximum number of focus results to copy and broadcast for each focus tag, the rest are dropped
+	 * Focus tags that aren't listed, or are 0, broadcast every result
+	 * Use UVigilSortBase::MaxResults in the preset to also avoid sorting targets that will be dropped
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil, meta=(UIMin="0", ClampMin="0"))
+	TMap<FGameplayTag, int32> MaxFocusResults;
+
+	/**
+	 * If true, a scan is skipped when the VigilTargetSelection source has not moved or rotated since the last scan
+	 * The current focus results are kept until the source moves, or ForcedRefreshInterval elapses
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil)
+	bool bSkipScansWhenSourceStationary = false;
+
+	/** Scans are skipped while the source has moved less than this distance since the last scan */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="bSkipScansWhenSourceStationary", UIMin="0", ClampMin="0", ForceUnits="cm"))
+	float StationaryLocationTolerance = 2.f;
+
+	/** Scans are skipped while the source has rotated less than this angle since the last scan */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="bSkipScansWhenSourceStationary", UIMin="0", ClampMin="0", ForceUnits="Degrees"))
+	float StationaryRotationTolerance = 0.5f;
+
+	/**
+	 * A scan is always performed if this much time has passed since the last scan, so moving targets are still picked up
+	 * Set to 0 to skip scans for as long as the source is stationary
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="bSkipScansWhenSourceStationary", UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float ForcedRefreshInterval = 0.5f;
+
+	/**
+	 * If true, Vigil runs from this component without a VigilScanAbility or ability system component
+	 * Intended for AI controllers that don't need GAS, results are broadcast via OnVigilTargetsReady and OnVigilFocusChanged
+	 * Net sync is not available without the ability
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil)
+	bool bStartScanDriverOnBeginPlay = false;
+
+	/** Settings used by StartScanDriver() */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="bStartScanDriverOnBeginPlay"))
+	FVigilScanDriverSettings ScanDriverSettings;
+
+	/** Scales the scan rate by significance, so components that are far away or off screen scan less often */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil)
+	FVigilScanLODSettings ScanLOD;
+
+	/**
+	 * Replaces the targeting preset for the same focus tag while significance is below ScanLOD.LowSignificanceThreshold
+	 * Use cheaper presets here, e.g. without line of sight checks. A null preset disables the focus tag
+	 */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category=Vigil, meta=(EditCondition="ScanLOD.Mode!=EVigilSignificanceMode::None"))
+	TMap<FGameplayTag, TObjectPtr<UTargetingPreset>> LowSignificancePresets;
+
 public:
 	/** Track any change in preset update mode so we can rebind delegates as required */
 	UPROPERTY(Transient)
@@ -56,19 +122,49 @@ public:
 	UPROPERTY(Transient)
 	float LastVigilScanTime = -1.f;
 
+	/** Used to throttle the update rate of each pipeline, keyed by GetPipelineTag() */
+	UPROPERTY(Transient)
+	TMap<FGameplayTag, float> LastPipelineScanTimes;
+
 	/** Current targeting presets that will be used to perform targeting requests */
 	UPROPERTY(Transient, DuplicateTransient)
 	TMap<FGameplayTag, TObjectPtr<UTargetingPreset>> CurrentTargetingPresets;
 
+	/** Last significance from UpdateVigilSignificance() */
+	UPROPERTY(Transient)
+	float Significance = 1.f;
+
+	/** World time significance was last updated */
+	UPROPERTY(Transient)
+	float LastSignificanceUpdateTime = -1.f;
+
+	/** True while LowSignificancePresets are in use */
+	UPROPERTY(Transient)
+	bool bLowSignificance = false;
+
+	/** Source pose used by the last scan of each focus tag, used by bSkipScansWhenSourceStationary */
+	TMap<FGameplayTag, FVigilScanSourcePose> LastScanSourcePoses;
+
 	/** Existing targeting request handles that are in-progress */
 	UPROPERTY(Transient)
 	TMap<FGameplayTag, FTargetingRequestHandle> TargetingRequests;
 
+	/**
+	 * Second in-progress request for each preset when VigilScan is pipelined
+	 * Promoted to TargetingRequests when the earlier request completes
+	 */
+	UPROPERTY(Transient)
+	TMap<FGameplayTag, FTargetingRequestHandle> PipelinedTargetingRequests;
+
 protected:
 	/** Owning controller */
 	UPROPERTY(Transient, DuplicateTransient)
 	TObjectPtr<AController> Controller = nullptr;
 
+	/** Runs our scans, either our own from StartScanDriver() or the VigilScanTask's */
+	UPROPERTY(Transient, DuplicateTransient)
+	TObjectPtr<UVigilScanDriver> ScanDriver = nullptr;
+
 public:
 	/** Delegate called when a targeting request is completed, populated with targeting results */
 	UPROPERTY(BlueprintAssignable, Category=Vigil)
@@ -78,11 +174,11 @@ public:
 	UPROPERTY(BlueprintAssignable, Category=Vigil)
 	FOnVigilFocusChanged OnVigilFocusChanged;
 	
-	/** VigilScanTask binds to this to pause itself when executed */
+	/** VigilScanDriver binds to this to pause itself when executed */
 	FOnPauseVigil OnPauseVigil;
 
 	/**
-	 * VigilScanTask binds to this to be notified of when a vigil is requested
+	 * VigilScanDriver binds to this to be notified of when a vigil is requested
 	 * This is a prerequisite for us to be able to end our own targeting requests
 	 * Otherwise, the vigil task would not ever receive the callback and know to continue
 	 */
@@ -113,7 +209,70 @@ public:
 	 */
 	UFUNCTION(BlueprintNativeEvent, Category=Vigil)
 	float GetMaxVigilScanRate() const;
-	virtual float GetMaxVigilScanRate_Implementation() const { return 0.f; }
+	virtual float GetMaxVigilScanRate_Implementation() const { return ApplyScanLOD(0.f); }
+
+	/**
+	 * Scale a scan rate by our significance, see ScanLOD
+	 * Call this from overrides of GetMaxVigilScanRate() to keep the LOD
+	 */
+	UFUNCTION(BlueprintPure, Category=Vigil)
+	float ApplyScanLOD(float ScanRate) const;
+
+	/**
+	 * Determine how relevant our scans are, from 0 (irrelevant) to 1 (fully relevant)
+	 * By default uses ScanLOD.Mode, override for EVigilSignificanceMode::Custom
+	 */
+	UFUNCTION(BlueprintNativeEvent, Category=Vigil)
+	float CalculateVigilSignificance() const;
+
+	/**
+	 * Update Significance if ScanLOD.UpdateInterval has elapsed, swapping to or from LowSignificancePresets if required
+	 * Called by VigilScanDriver before each scan
+	 */
+	UFUNCTION(BlueprintCallable, Category=Vigil)
+	void UpdateVigilSignificance(bool bForce = false);
+
+	/** @return Our significance, from 0 (irrelevant) to 1 (fully relevant) */
+	UFUNCTION(BlueprintPure, Category=Vigil)
+	float GetVigilSignificance() const { return Significance; }
+
+	/**
+	 * Vigil will scan the pipeline for this focus tag at this rate, if it can keep up
+	 * By default uses PipelineSettings, falling back to GetMaxVigilScanRate()
+	 * @param PipelineTag The pipeline's tag, empty when bIndependentPresetPipelines is disabled
+	 */
+	UFUNCTION(BlueprintNativeEvent, Category=Vigil)
+	float GetMaxVigilPipelineScanRate(const FGameplayTag& PipelineTag) const;
+
+	/** Higher priority pipelines are issued first when the VigilScanScheduler is over budget */
+	UFUNCTION(BlueprintNativeEvent, Category=Vigil)
+	int32 GetVigilPipelinePriority(const FGameplayTag& PipelineTag) const;
+
+	/** @return Maximum number of focus results to broadcast for the focus tag, 0 for every result */
+	int32 GetMaxFocusResults(const FGameplayTag& FocusTag) const
+	{
+		const int32* MaxResults = MaxFocusResults.Find(FocusTag);
+		return MaxResults ? FMath::Max(0, *MaxResults) : 0;
+	}
+
+	/** @return The pipeline that the preset with this focus tag runs in */
+	FGameplayTag GetPipelineTag(const FGameplayTag& FocusTag) const
+	{
+		return bIndependentPresetPipelines ? FocusTag : FGameplayTag::EmptyTag;
+	}
+
+	/** @return True if any targeting request in the pipeline is still in progress */
+	bool IsPipelineInFlight(const FGameplayTag& PipelineTag) const;
+
+	/**
+	 * @return True if the scan for this focus tag can be skipped because the source has not moved
+	 * Records the pose as the last scanned pose when the scan is not skipped
+	 */
+	bool ShouldSkipStationaryScan(const FGameplayTag& FocusTag, const FVector& SourceLocation, const FQuat& SourceRotation);
+
+	/** Forget the last scanned source poses so the next scan is never skipped */
+	UFUNCTION(BlueprintCallable, Category=Vigil)
+	void InvalidateScanSourcePoses() { LastScanSourcePoses.Reset(); }
 
 	/** Get the Targeting Source passed to the targeting system */
 	UFUNCTION(BlueprintNativeEvent, Category=Vigil)
@@ -125,6 +284,24 @@ public:
 
 public:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/**
+	 * Start running Vigil from this component using ScanDriverSettings, without a VigilScanAbility
+	 * Does nothing if a VigilScanTask is already scanning for us
+	 */
+	UFUNCTION(BlueprintCallable, Category=Vigil)
+	void StartScanDriver();
+
+	/** Stop running Vigil from this component, if started by StartScanDriver() */
+	UFUNCTION(BlueprintCallable, Category=Vigil)
+	void StopScanDriver();
+
+	/** @return The driver running our scans, if any */
+	UVigilScanDriver* GetScanDriver() const { return ScanDriver; }
+
+	/** Called by UVigilScanTask to share its driver, so StartScanDriver() doesn't run a second scan loop */
+	void SetScanDriver(UVigilScanDriver* InScanDriver) { ScanDriver = InScanDriver; }
 
 	/** Rebind the OnPossessedPawnChanged binding if the requirement changes */
 	void UpdatePawnChangedBinding();
@@ -148,7 +325,7 @@ public:
 	AActor* GetFocusActor(FGameplayTag FocusTag) const;
 
 	/**
-	 * Notified by UVigilScanTask that our targets are ready
+	 * Notified by UVigilScanDriver that our targets are ready
 	 * Cache the results and notify any listeners
 	 */
 	void VigilTargetsReady(const FGameplayTag& FocusTag, const TArray<FVigilFocusResult>& Results);
@@ -212,6 +389,5 @@ public:
 	/** Vigil Scan Task calls this when it completes the net sync and has performed a synchronous targeting update */
 	void OnNetSyncCallback();
 
-protected:
 	FString GetRoleString() const;
 };
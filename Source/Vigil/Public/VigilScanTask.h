@@ -9,10 +9,11 @@
 
 class UVigilNetSyncTask;
 class UVigilComponent;
-struct FTargetingRequestHandle;
+class UVigilScanDriver;
 
 /**
  * Vigil's passive perpetual task that scans for focus targets
+ * The scan loop itself is run by UVigilScanDriver, this task adds net sync support via the ability
  */
 UCLASS()
 class VIGIL_API UVigilScanTask : public UAbilityTask
@@ -20,18 +21,17 @@ class VIGIL_API UVigilScanTask : public UAbilityTask
 	GENERATED_BODY()
 
 public:
+	/** Retries finding the VigilComponent until the controller is available */
 	UPROPERTY()
 	FTimerHandle VigilWaitTimer;
 
-	UPROPERTY()
-	FTimerHandle FailsafeTimer;
-
 protected:
 	UPROPERTY()
 	TWeakObjectPtr<UVigilComponent> VC;
 
-	TOptional<FString> WaitReason;
-	TOptional<FString> VeryVerboseWaitReason;
+	/** Runs our scans */
+	UPROPERTY(Transient)
+	TObjectPtr<UVigilScanDriver> Driver;
 	
 public:
 	UVigilScanTask(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
@@ -41,24 +41,17 @@ public:
 	 * @param OwningAbility The ability that owns this task
 	 * @param ErrorWaitDelay Delay before we attempt any requests after encountering an error
 	 * @param FailsafeDelay Delay before we request a new target if we don't get one
+	 * @param bPipelined If true, the next request for a preset is issued while the previous one is still in progress,
+	 *	so scan throughput is not limited by the async round trip or by how long the results take to broadcast
 	 */
-	UFUNCTION(BlueprintCallable, Category="Ability|Tasks", meta = (HidePin = "OwningAbility", DefaultToSelf = "OwningAbility", BlueprintInternalUseOnly = "TRUE", DisplayName="Vigil Scan"))
-	static UVigilScanTask* VigilScan(UGameplayAbility* OwningAbility, float ErrorWaitDelay = 0.5f, float FailsafeDelay = 1.f);
+	UFUNCTION(BlueprintCallable, Category="Ability|Tasks", meta = (HidePin = "OwningAbility", DefaultToSelf = "OwningAbility", BlueprintInternalUseOnly = "TRUE", DisplayName="Vigil Scan", AdvancedDisplay="bPipelined"))
+	static UVigilScanTask* VigilScan(UGameplayAbility* OwningAbility, float ErrorWaitDelay = 0.5f, float FailsafeDelay = 1.f,
+		bool bPipelined = false);
 
 	virtual void Activate() override;
 
-	void WaitForVigil(float InDelay, const TOptional<FString>& Reason = {}, const TOptional<FString>& VeryVerboseReason = {});
-	void RequestVigil();
-	void OnVigilCompleteSync(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag);
-	void OnVigilComplete(FTargetingRequestHandle TargetingHandle, FGameplayTag FocusTag);
-
-	/** Broadcast from VigilComponent */
-	UFUNCTION()
-	void OnPauseVigil(bool bPaused);
-
-	/** Broadcast from VigilComponent after all our tasks were removed, i.e. we never get our callback to continue */
-	UFUNCTION()
-	void OnRequestVigil();
+	/** Find the VigilComponent on the owning controller and start the driver, retrying until the controller is available */
+	void StartDriver();
 
 	UFUNCTION()
 	void OnRequestNetSync(EVigilNetSyncType SyncType);
@@ -70,18 +63,12 @@ public:
 
 protected:
 	UPROPERTY()
-	float Delay = 0.5f;
-
-	UPROPERTY()
-	float FailsafeDelay = 1.f;
+	FVigilScanDriverSettings Settings;
 	
 	/** Tracked to prevent premature GC and allow ending during OnDestroy */
 	UPROPERTY(Transient)
 	TArray<TObjectPtr<UVigilNetSyncTask>> SyncTasks;
 
-	/** Delayed callback until we get the next targets */
-	EVigilNetSyncPendingState PendingNetSync = EVigilNetSyncPendingState::None;
-
 	ENetMode GetOwnerNetMode() const;
 	FString GetRoleString() const;
 };
@@ -71,9 +71,187 @@ struct VIGIL_API FVigilConeShape
 
 	FVector GetConeBoxShapeHalfExtent() const;
 
+	/** @return Tan of half the angle, used to test points against the cone without Atan2 */
+	static float GetTanHalfAngle(float Angle);
+
 	static FVigilConeShape MakeConeFromScalableFloat(const FScalableFloat& Length, const FScalableFloat& AngleWidth, const FScalableFloat& AngleHeight);
 };
 
+/**
+ * Settings for a single focus tag's scan pipeline
+ * Each pipeline has its own rate and in-flight request, so a slow preset does not hold back the others
+ */
+USTRUCT(BlueprintType)
+struct VIGIL_API FVigilPipelineSettings
+{
+	GENERATED_BODY()
+
+	FVigilPipelineSettings(float InMaxScanRate = -1.f, int32 InPriority = 0)
+		: MaxScanRate(InMaxScanRate)
+		, Priority(InPriority)
+	{}
+
+	/**
+	 * Minimum time between scans for this pipeline
+	 * Set to 0 to disable throttling, or below 0 to use GetMaxVigilScanRate()
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(UIMin="-1", ClampMin="-1", Delta="0.01", ForceUnits="s"))
+	float MaxScanRate;
+
+	/** Higher priority pipelines are issued first when the VigilScanScheduler is over budget */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil)
+	int32 Priority;
+};
+
+UENUM(BlueprintType)
+enum class EVigilSignificanceMode : uint8
+{
+	None				UMETA(ToolTip="Always fully significant, the scan rate is never scaled"),
+	ViewerDistance		UMETA(ToolTip="Significance falls off with distance from the targeting source to the nearest local viewer"),
+	OnScreen			UMETA(ToolTip="Fully significant while the targeting source was recently rendered, otherwise insignificant"),
+	SignificanceManager	UMETA(ToolTip="Use the targeting source's significance from the Significance Manager, which must be enabled and registered by your project, otherwise significance is not scaled"),
+	Custom				UMETA(ToolTip="Override UVigilComponent::CalculateVigilSignificance"),
+};
+
+/**
+ * Scan level of detail, scales a VigilComponent's scan rate by its significance
+ * Significance is 0 (irrelevant) to 1 (fully relevant), see UVigilComponent::CalculateVigilSignificance()
+ */
+USTRUCT(BlueprintType)
+struct VIGIL_API FVigilScanLODSettings
+{
+	GENERATED_BODY()
+
+	/** How significance is determined */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil)
+	EVigilSignificanceMode Mode = EVigilSignificanceMode::None;
+
+	/** Components owned by a local player controller are always fully significant */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode!=EVigilSignificanceMode::None", EditConditionHides))
+	bool bAlwaysSignificantForLocalPlayer = true;
+
+	/** Fully significant within this distance of a viewer */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode==EVigilSignificanceMode::ViewerDistance", EditConditionHides, UIMin="0", ClampMin="0", ForceUnits="cm"))
+	float NearDistance = 1500.f;
+
+	/** Insignificant beyond this distance from every viewer */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode==EVigilSignificanceMode::ViewerDistance", EditConditionHides, UIMin="0", ClampMin="0", ForceUnits="cm"))
+	float FarDistance = 6000.f;
+
+	/**
+	 * The targeting source is on screen if rendered within this time
+	 * Nothing is rendered on a dedicated server, so every component is insignificant there
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode==EVigilSignificanceMode::OnScreen", EditConditionHides, UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float OnScreenTolerance = 0.2f;
+
+	/** Significance Manager values are divided by this to normalize them */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode==EVigilSignificanceMode::SignificanceManager", EditConditionHides, UIMin="0.001", ClampMin="0.001"))
+	float MaxSignificance = 1.f;
+
+	/**
+	 * Minimum time between scans when insignificant
+	 * Interpolated towards the unscaled scan rate as significance increases, the scan rate is never made faster
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode!=EVigilSignificanceMode::None", EditConditionHides, UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float LowSignificanceScanRate = 0.5f;
+
+	/** Below this significance UVigilComponent::LowSignificancePresets are used */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode!=EVigilSignificanceMode::None", EditConditionHides, UIMin="0", ClampMin="0", UIMax="1", ClampMax="1"))
+	float LowSignificanceThreshold = 0.25f;
+
+	/** Minimum time between significance updates */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(EditCondition="Mode!=EVigilSignificanceMode::None", EditConditionHides, UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float UpdateInterval = 0.25f;
+};
+
+/** Source pose used by the last scan of a focus tag, used to skip scans when the source has not moved */
+struct VIGIL_API FVigilScanSourcePose
+{
+	FVigilScanSourcePose(const FVector& InLocation = FVector::ZeroVector, const FQuat& InRotation = FQuat::Identity,
+		float InScanTime = -1.f)
+		: Location(InLocation)
+		, Rotation(InRotation)
+		, ScanTime(InScanTime)
+	{}
+
+	FVector Location;
+	FQuat Rotation;
+
+	/** World time of the last scan that was not skipped */
+	float ScanTime;
+};
+
+/** Settings for UVigilScanDriver, which runs Vigil's scan loop */
+USTRUCT(BlueprintType)
+struct VIGIL_API FVigilScanDriverSettings
+{
+	GENERATED_BODY()
+
+	FVigilScanDriverSettings(float InErrorWaitDelay = 0.5f, float InFailsafeDelay = 1.f, bool bInPipelined = false)
+		: ErrorWaitDelay(InErrorWaitDelay)
+		, FailsafeDelay(InFailsafeDelay)
+		, bPipelined(bInPipelined)
+	{}
+
+	/** Delay before we attempt any requests after encountering an error */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float ErrorWaitDelay;
+
+	/** Delay before we request a new target if we don't get one */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil, meta=(UIMin="0", ClampMin="0", Delta="0.01", ForceUnits="s"))
+	float FailsafeDelay;
+
+	/**
+	 * If true, the next request for a preset is issued while the previous one is still in progress,
+	 * so scan throughput is not limited by the async round trip or by how long the results take to broadcast
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Vigil)
+	bool bPipelined;
+};
+
+/**
+ * Distance and angle from the source to a target, computed once per targeting request and shared by every sort task
+ * @see FVigilTargetingRequestData::CandidateMetrics
+ */
+USTRUCT(BlueprintType)
+struct VIGIL_API FVigilTargetMetrics
+{
+	GENERATED_BODY()
+
+	/** False if the request had no FVigilTargetingRequestData, i.e. no VigilTargetSelection */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	bool bValid = false;
+
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float Distance = 0.f;
+
+	/** Distance as 0-1 of MaxDistance */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float NormalizedDistance = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float MaxDistance = 0.f;
+
+	/** Angle in degrees from the source direction */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float Angle = 0.f;
+
+	/** Angle as 0-1 of MaxAngle */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float NormalizedAngle = 0.f;
+
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float MaxAngle = 0.f;
+
+	/** Cosine of Angle, orders targets the same as Angle without the Acos */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	float AngleCos = 1.f;
+
+	/** Angle and NormalizedAngle are only computed when something asks for them */
+	bool bHasAngle = false;
+};
+
 USTRUCT(BlueprintType)
 struct VIGIL_API FVigilFocusResult
 {
@@ -95,6 +273,10 @@ struct VIGIL_API FVigilFocusResult
 
 	UPROPERTY(BlueprintReadOnly, Category=Vigil)
 	float Score;
+
+	/** Distance and angle computed during the targeting request, invalid if it had no VigilTargetSelection */
+	UPROPERTY(BlueprintReadOnly, Category=Vigil)
+	FVigilTargetMetrics Metrics;
 	
 	UPROPERTY(Transient)
 	TObjectPtr<AActor> LastFocusActor;
@@ -1,5 +1,6 @@
 ﻿// Copyright (c) Jared Taylor
 
+using System.Linq;
 using UnrealBuildTool;
 
 public class Vigil : ModuleRules
@@ -25,8 +26,42 @@ public class Vigil : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"AIModule",
 				"UMG",
 			}
 			);
+
+		// The Significance Manager plugin is optional, EVigilSignificanceMode::SignificanceManager falls back to full significance without it
+		if (IsSignificanceManagerEnabled(Target))
+		{
+			PrivateDependencyModuleNames.Add("SignificanceManager");
+			PrivateDefinitions.Add("WITH_VIGIL_SIGNIFICANCE_MANAGER=1");
+		}
+		else
+		{
+			PrivateDefinitions.Add("WITH_VIGIL_SIGNIFICANCE_MANAGER=0");
+		}
+	}
+
+	private static bool IsSignificanceManagerEnabled(ReadOnlyTargetRules Target)
+	{
+		const string PluginName = "SignificanceManager";
+		if (Target.DisablePlugins.Contains(PluginName))
+		{
+			return false;
+		}
+
+		if (Target.EnablePlugins.Contains(PluginName))
+		{
+			return true;
+		}
+
+		if (Target.ProjectFile == null)
+		{
+			return false;
+		}
+
+		ProjectDescriptor Project = ProjectDescriptor.FromFile(Target.ProjectFile);
+		return Project.Plugins != null && Project.Plugins.Any(Plugin => Plugin.Name == PluginName && Plugin.bEnabled);
 	}
 }